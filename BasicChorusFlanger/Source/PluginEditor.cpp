@@ -151,6 +151,47 @@ BasicChorusFlangerAudioProcessorEditor::BasicChorusFlangerAudioProcessorEditor (
     };
 
     mType.setSelectedItemIndex(*typeParameter);
+
+    // LFO Shape Combo Box
+
+    AudioParameterInt* shapeParameter = (AudioParameterInt*)params.getUnchecked(6);
+
+    mShape.setBounds(200, 100, 100, 30);
+    mShape.addItem("Sine", 1);
+    mShape.addItem("Triangle", 2);
+    mShape.addItem("Square", 3);
+    mShape.addItem("Sample & Hold", 4);
+    mShape.addItem("Smooth Random", 5);
+    addAndMakeVisible(mShape);
+
+    mShape.onChange = [this, shapeParameter] {
+        shapeParameter->beginChangeGesture();
+        *shapeParameter = mShape.getSelectedItemIndex();
+        shapeParameter->endChangeGesture();
+    };
+
+    mShape.setSelectedItemIndex(*shapeParameter);
+
+    // Interpolation Combo Box
+
+    AudioParameterInt* interpolationParameter = (AudioParameterInt*)params.getUnchecked(7);
+
+    mInterpolation.setBounds(300, 100, 100, 30);
+    mInterpolation.addItem("Linear", 1);
+    mInterpolation.addItem("Hermite", 2);
+    mInterpolation.addItem("Lagrange", 3);
+    mInterpolation.addItem("Thiran", 4);
+    mInterpolation.addItem("Sinc 8", 5);
+    mInterpolation.addItem("Sinc 16", 6);
+    addAndMakeVisible(mInterpolation);
+
+    mInterpolation.onChange = [this, interpolationParameter] {
+        interpolationParameter->beginChangeGesture();
+        *interpolationParameter = mInterpolation.getSelectedItemIndex();
+        interpolationParameter->endChangeGesture();
+    };
+
+    mInterpolation.setSelectedItemIndex(*interpolationParameter);
 }
 
 BasicChorusFlangerAudioProcessorEditor::~BasicChorusFlangerAudioProcessorEditor() {
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include "JuceHeader.h"
 #include "PluginProcessor.h"
 
 //==============================================================================
@@ -30,6 +30,8 @@ private:
     Slider mFeedbackSlider;
 
     ComboBox mType;
+    ComboBox mShape;
+    ComboBox mInterpolation;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BasicChorusFlangerAudioProcessorEditor)
 
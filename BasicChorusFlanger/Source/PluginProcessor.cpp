@@ -21,29 +21,17 @@ BasicChorusFlangerAudioProcessor::BasicChorusFlangerAudioProcessor()
     addParameter(mPhaseOffsetParam = new AudioParameterFloat("phaseoffset", "PhaseOffset", 0.0f, 1.0f, 0.f));
     addParameter(mFeedbackParam = new AudioParameterFloat("feedback", "Feedback", 0, 0.98, 0.5));
     addParameter(mTypeParam = new AudioParameterInt("type", "Type", 0, 1, 0));
+    addParameter(mShapeParam = new AudioParameterInt("shape", "Shape", 0, 4, 0));
+    addParameter(mInterpolationParam = new AudioParameterInt("interpolation", "Interpolation", 0, 5, 0));
 
-    // Initialize data to default values
-    mCircularBufferLeft = nullptr;
-    mCircularBufferRight = nullptr;
-    mCircularBufferWriteHead = 0;
-    mCircularBufferLength = 0;
-
-    mFeedbackLeft = 0;
-    mFeedbackRight = 0;
-
-    mLFOPhase = 0;
+    // 0 is off, 1 is 2x and 2 is 4x. Only taken up at the next prepareToPlay(), since it changes the latency.
+    addParameter(mOversamplingParam = new AudioParameterInt("oversampling", "Oversampling", 0, 2, 0));
+    addParameter(mOversampleOfflineOnlyParam = new AudioParameterBool("oversampleoffline", "Oversample Offline Only", true));
+    addParameter(mVoicesParam = new AudioParameterInt("voices", "Voices", 1, MAX_VOICES, 1));
 }
 
 BasicChorusFlangerAudioProcessor::~BasicChorusFlangerAudioProcessor() {
-    if (mCircularBufferLeft != nullptr) {
-        delete [] mCircularBufferLeft;
-        mCircularBufferLeft = nullptr;
-    }
 
-    if (mCircularBufferRight != nullptr) {
-        delete [] mCircularBufferRight;
-        mCircularBufferRight = nullptr;
-    }
 }
 
 //==============================================================================
@@ -76,7 +64,10 @@ bool BasicChorusFlangerAudioProcessor::isMidiEffect() const {
 }
 
 double BasicChorusFlangerAudioProcessor::getTailLengthSeconds() const {
-    return 0.0;
+    // The voices are averaged, so the wet signal comes back at the feedback level each time
+    // round, which takes as long as the furthest back a voice reads
+    const double longestDelayTime = getLongestDelayTime(mTypeParam->get(), mVoicesParam->get());
+    return getFeedbackTailSeconds(mFeedbackParam->get(), longestDelayTime, longestDelayTime);
 }
 
 int BasicChorusFlangerAudioProcessor::getNumPrograms() {
@@ -100,29 +91,72 @@ void BasicChorusFlangerAudioProcessor::changeProgramName (int index, const Strin
 
 //==============================================================================
 void BasicChorusFlangerAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock) {
-    // Initialize data for current sample rate of the host, and reset phase & write heads.
-    mCircularBufferLength = sampleRate * MAX_DELAY_TIME;
-    mLFOPhase = 0;
-
-    // Initialize left and right buffer, clearing any garbage in the process.
-    if (mCircularBufferLeft == nullptr) {
-        delete [] mCircularBufferLeft;
-        mCircularBufferLeft = new float[mCircularBufferLength];
-    }
+    // Fast, deep flanger sweeps alias at the host's rate. Oversampling runs everything below at
+    // 2x or 4x instead, which costs much less than raising the rate of the whole session. By
+    // default that's only for offline renders, where the extra CPU and latency don't matter.
+    const bool canOversample = ! *mOversampleOfflineOnlyParam || isNonRealtime();
+    mOversamplingFactor = canOversample ? 1 << *mOversamplingParam : 1;
+
+    const double oversampledRate = sampleRate * mOversamplingFactor;
+    const int oversampledBlockSize = samplesPerBlock * mOversamplingFactor;
+
+    mArena.build([this, sampleRate, samplesPerBlock, oversampledRate, oversampledBlockSize] {
+        // Initialize data for current sample rate of the host, and reset phase & write heads.
+        mLFO.prepare(oversampledRate, oversampledBlockSize);
+
+        // Only the delay lines for the precision the host asked for are used
+        if (isUsingDoublePrecision()) {
+            prepareState(mDoubleState, sampleRate, samplesPerBlock);
+            mFloatState = ChorusState<float>();
+        } else {
+            prepareState(mFloatState, sampleRate, samplesPerBlock);
+            mDoubleState = ChorusState<double>();
+        }
 
-    // Clear the buffers after instantiating!
-    zeromem(mCircularBufferLeft, mCircularBufferLength * sizeof(float));
+        // Ramp times are in milliseconds, so their step sizes depend on the sample rate
+        for (auto* smoothed : { &mDryWetSmoothed, &mDepthSmoothed, &mRateSmoothed, &mPhaseOffsetSmoothed, &mFeedbackSmoothed }) {
+            smoothed->prepare(oversampledRate, oversampledBlockSize);
+        }
 
-    if (mCircularBufferRight == nullptr) {
-        delete [] mCircularBufferRight;
-        mCircularBufferRight = new float[mCircularBufferLength];
-    }
+        mDryWetSmoothed.setCurrentAndTargetValue(*mDryWetParam);
+        mDepthSmoothed.setCurrentAndTargetValue(*mDepthParam);
+        mRateSmoothed.setCurrentAndTargetValue(*mRateParam);
+        mPhaseOffsetSmoothed.setCurrentAndTargetValue(*mPhaseOffsetParam);
+        mFeedbackSmoothed.setCurrentAndTargetValue(*mFeedbackParam);
 
-    // Clear the buffers after instantiating!
-    zeromem(mCircularBufferRight, mCircularBufferLength * sizeof(float));
+        // One block of LFO output per channel, later mapped to delay times
+        mLFOBuffer.setSize(3, mDryWetSmoothed.getMaxBlockSize());
+    });
+
+    // The filters on the way up and down delay everything, dry signal included, so the host is told to
+    // compensate. That's once the arena's done, since a host can take each change as a new latency.
+    setLatencySamples(isUsingDoublePrecision() ? mDoubleState.oversamplerLeft.getLatency()
+                                               : mFloatState.oversamplerLeft.getLatency());
+}
 
-    // Reset write head.
-    mCircularBufferWriteHead = 0;
+template <typename SampleType>
+void BasicChorusFlangerAudioProcessor::prepareState (ChorusState<SampleType>& state, double sampleRate, int samplesPerBlock) {
+    // Initialize left and right delay lines, clearing any garbage in the process. They're sized
+    // for the longest modulated delay rather than seconds of audio, so they stay in cache.
+    const int maxDelayInSamples = (int) std::ceil(sampleRate * mOversamplingFactor * MAX_DELAY_TIME);
+    state.delayLineLeft.prepare(maxDelayInSamples);
+    state.delayLineRight.prepare(maxDelayInSamples);
+
+    state.feedbackLeft = 0;
+    state.feedbackRight = 0;
+    std::fill(state.allpassStatesLeft, state.allpassStatesLeft + MAX_VOICES, SampleType());
+    std::fill(state.allpassStatesRight, state.allpassStatesRight + MAX_VOICES, SampleType());
+
+    // The filters on the way up and down delay everything, dry signal included
+    const int maxBlockSize = jmax(1, samplesPerBlock);
+    state.oversamplerLeft.prepare(mOversamplingFactor, maxBlockSize);
+    state.oversamplerRight.prepare(mOversamplingFactor, maxBlockSize);
+    state.oversampledBuffer.setSize(2, mOversamplingFactor > 1 ? mOversamplingFactor * maxBlockSize : 0);
+    state.blockBuffer.setSize(6, mOversamplingFactor * maxBlockSize);
+
+    state.numSilentSamples = 0;
+
+    state.isPrepared = true;
 }
 
 void BasicChorusFlangerAudioProcessor::releaseResources() {
@@ -154,19 +188,23 @@ bool BasicChorusFlangerAudioProcessor::isBusesLayoutSupported (const BusesLayout
 #endif
 
 void BasicChorusFlangerAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages) {
+    process(buffer);
+}
+
+void BasicChorusFlangerAudioProcessor::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midiMessages) {
+    process(buffer);
+}
+
+bool BasicChorusFlangerAudioProcessor::supportsDoublePrecisionProcessing() const {
+    return true;
+}
+
+template <typename SampleType>
+void BasicChorusFlangerAudioProcessor::process (AudioBuffer<SampleType>& buffer) {
     ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
-    /** Debug
-    DBG("Dry/Wet: " << *mDryWetParam);
-    DBG("Depth: " << *mDepthParam);
-    DBG("Rate: " << *mRateParam);
-    DBG("Phase: " << *mPhaseOffsetParam);
-    DBG("Feedback: " << *mFeedbackParam);
-    DBG("Type: " << (int)*mTypeParam);
-    */
-
     // In case we have more outputs than inputs, this code clears any output
     // channels that didn't contain input data, (because these aren't
     // guaranteed to be empty - they may contain garbage).
@@ -177,107 +215,260 @@ void BasicChorusFlangerAudioProcessor::processBlock (AudioBuffer<float>& buffer,
         buffer.clear (i, 0, buffer.getNumSamples());
     }
 
-    float* leftChannel = buffer.getWritePointer(0);
-    float* rightChannel = buffer.getWritePointer(1);
+    auto& state = getState(buffer);
 
-    // Iterate through all samples in the buffer
-    for (int i = 0; i < buffer.getNumSamples(); i++) {
+    // Not prepared for this precision, so leave the dry signal
+    if (! state.isPrepared) {
+        return;
+    }
 
-        // Write incoming data into circular buffer
-        mCircularBufferLeft[mCircularBufferWriteHead] = leftChannel[i] + mFeedbackLeft;
-        mCircularBufferRight[mCircularBufferWriteHead] = rightChannel[i] + mFeedbackRight;
+    SampleType* leftChannel = buffer.getWritePointer(0);
+    SampleType* rightChannel = buffer.getWritePointer(1);
 
-        // Generate L LFO output
-        float lfoOutLeft = sin(2 * M_PI * mLFOPhase);
+    // Take one snapshot of the parameters per block, so the loop below only works on plain floats
+    mDryWetSmoothed.setTargetValue(*mDryWetParam);
+    mDepthSmoothed.setTargetValue(*mDepthParam);
+    mRateSmoothed.setTargetValue(*mRateParam);
+    mPhaseOffsetSmoothed.setTargetValue(*mPhaseOffsetParam);
+    mFeedbackSmoothed.setTargetValue(*mFeedbackParam);
 
-        // Calculate the R channel's LFO phase
-        float lfoPhaseRight = mLFOPhase + *mPhaseOffsetParam;
-        // Clamp LFO phase to 1
-        if (lfoPhaseRight > 1) {
-            lfoPhaseRight -= 1;
-        }
+    const int type = *mTypeParam;
+    mLFO.setShape((LFO<float>::Shape) (int) *mShapeParam);
 
-        // Generate R LFO output
-        float lfoOutRight = sin(2 * M_PI * lfoPhaseRight);
+    const auto interpolation = (Interpolation) (int) *mInterpolationParam;
 
-        mLFOPhase += *mRateParam / getSampleRate();
+    // The delay lines drop their allpass state when the kernel changes, so the voices do too
+    if (interpolation != state.delayLineLeft.getInterpolation()) {
+        std::fill(state.allpassStatesLeft, state.allpassStatesLeft + MAX_VOICES, SampleType());
+        std::fill(state.allpassStatesRight, state.allpassStatesRight + MAX_VOICES, SampleType());
+    }
 
-        // Ensure the LFO phase is bounded between 0 and 1.
-        if (mLFOPhase > 1) {
-            mLFOPhase -= 1;
+    state.delayLineLeft.setInterpolation(interpolation);
+    state.delayLineRight.setInterpolation(interpolation);
+
+    // Everything from here on runs at the oversampled rate
+    const float sampleRate = getSampleRate() * mOversamplingFactor;
+
+    // Chorus maps the LFO to 5 - 30ms of delay, flanger to 1 - 5ms
+    const float minDelayTime = type == 0 ? CHORUS_MIN_DELAY_TIME : FLANGER_MIN_DELAY_TIME;
+    const float maxDelayTime = type == 0 ? CHORUS_MAX_DELAY_TIME : FLANGER_MAX_DELAY_TIME;
+    const int numVoices = *mVoicesParam;
+
+    // Once everything the voices can reach went into the delay lines silent, and the input still is,
+    // the block is left as it is. The delay lines and the ramps move on as though it had been
+    // processed, so voices that reach further back later on, with more of them or the chorus
+    // after the flanger, find the silence that would have been written there.
+    const int reach = (int) std::ceil(sampleRate * getLongestDelayTime(type, numVoices)) + SincInterpolator<SampleType, 16>::numTaps;
+
+    if (state.numSilentSamples >= reach) {
+        bool inputIsSilent = false;
+
+        dispatchSIMD([&] {
+            inputIsSilent = isSilent(leftChannel, buffer.getNumSamples()) && isSilent(rightChannel, buffer.getNumSamples());
+        });
+
+        if (inputIsSilent) {
+            const int numOversampledSamples = buffer.getNumSamples() * mOversamplingFactor;
+
+            state.delayLineLeft.advance(numOversampledSamples);
+            state.delayLineRight.advance(numOversampledSamples);
+            state.feedbackLeft = 0;
+            state.feedbackRight = 0;
+            std::fill(state.allpassStatesLeft, state.allpassStatesLeft + MAX_VOICES, SampleType());
+            std::fill(state.allpassStatesRight, state.allpassStatesRight + MAX_VOICES, SampleType());
+
+            // The oversampling filters only hold the last few dozen samples, which were silent too,
+            // so they're cleared to what running the block through them would have left
+            state.oversamplerLeft.reset();
+            state.oversamplerRight.reset();
+            state.numSilentSamples = jmin(state.numSilentSamples + numOversampledSamples, 1 << 30);
+
+            // The LFO still keeps time, so the sweep comes back in where it would have been. That's
+            // one add a sample, where processing would have read every voice.
+            for (int start = 0; start < numOversampledSamples; start += mRateSmoothed.getMaxBlockSize()) {
+                const int numSamples = jmin(mRateSmoothed.getMaxBlockSize(), numOversampledSamples - start);
+                mLFO.advance(mRateSmoothed.getRamp(numSamples), numSamples);
+            }
+
+            for (auto* smoothed : { &mDryWetSmoothed, &mDepthSmoothed, &mPhaseOffsetSmoothed, &mFeedbackSmoothed }) {
+                smoothed->skip(numOversampledSamples);
+            }
+
+            return;
         }
+    }
 
-        // LFO depth is multipled by the depth parameter
-        lfoOutLeft *= *mDepthParam;
-        lfoOutRight *= *mDepthParam;
+    if (mOversamplingFactor == 1) {
+        processChunks(state, leftChannel, rightChannel, buffer.getNumSamples(), sampleRate, minDelayTime, maxDelayTime, numVoices);
+        return;
+    }
 
-        // Map LFO output to the delay time for each channel
-        float lfoOutMappedLeft = 0;
-        float lfoOutMappedRight = 0;
+    // Take the host's block in chunks that fill the oversampled buffer, and run each one up, through and back down
+    const int maxChunkSize = state.oversampledBuffer.getNumSamples() / mOversamplingFactor;
+    SampleType* oversampledLeft = state.oversampledBuffer.getWritePointer(0);
+    SampleType* oversampledRight = state.oversampledBuffer.getWritePointer(1);
 
-        // Chorus Effect
-        if (*mTypeParam == 0) {
-            // Map the LFO value to a range of time values (5 - 30ms)
-            lfoOutMappedLeft = jmap(lfoOutLeft, -1.0f, 1.0f, 0.005f, 0.03f);
-            lfoOutMappedRight = jmap(lfoOutRight, -1.0f, 1.0f, 0.005f, 0.03f);
-        } else {
-            // Flanger Effect
-            lfoOutMappedLeft = jmap(lfoOutLeft, -1.0f, 1.0f, 0.001f, 0.005f);
-            lfoOutMappedRight = jmap(lfoOutRight, -1.0f, 1.0f, 0.001f, 0.005f);
-        }
+    for (int start = 0; start < buffer.getNumSamples(); start += maxChunkSize) {
+        const int numSamples = jmin(maxChunkSize, buffer.getNumSamples() - start);
 
-        // Calculate delay lengths in samples
-        float delayTimeSamplesLeft = getSampleRate() * lfoOutMappedLeft;
-        float delayTimeSamplesRight = getSampleRate() * lfoOutMappedRight;
+        dispatchSIMD([&] {
+            state.oversamplerLeft.upsample(leftChannel + start, oversampledLeft, numSamples);
+            state.oversamplerRight.upsample(rightChannel + start, oversampledRight, numSamples);
+        });
 
-        // Calculate the L read head position
-        float delayReadHeadLeft = mCircularBufferWriteHead - delayTimeSamplesLeft;
-        if (delayReadHeadLeft < 0) {
-            delayReadHeadLeft += mCircularBufferLength;
-        }
+        processChunks(state, oversampledLeft, oversampledRight, numSamples * mOversamplingFactor, sampleRate, minDelayTime, maxDelayTime, numVoices);
 
-        // Calculate the R read head position
-        float delayReadHeadRight = mCircularBufferWriteHead - delayTimeSamplesRight;
-        if (delayReadHeadRight < 0) {
-            delayReadHeadRight += mCircularBufferLength;
-        }
+        dispatchSIMD([&] {
+            state.oversamplerLeft.downsample(oversampledLeft, leftChannel + start, numSamples);
+            state.oversamplerRight.downsample(oversampledRight, rightChannel + start, numSamples);
+        });
+    }
+}
 
-        // Linear interpolation for L channel
-        int readHeadLeft_x = (int) delayReadHeadLeft;
-        int readHeadLeft_x1 = readHeadLeft_x + 1;
-        float readHeadFloatLeft = delayReadHeadLeft - readHeadLeft_x;
-        if (readHeadLeft_x1 >= mCircularBufferLength) {
-            readHeadLeft_x1 -= mCircularBufferLength;
-        }
+template <typename SampleType>
+void BasicChorusFlangerAudioProcessor::processChunks (ChorusState<SampleType>& state, SampleType* leftChannel, SampleType* rightChannel,
+                                                      int numSamplesToProcess, float sampleRate, float minDelayTime, float maxDelayTime,
+                                                      int numVoices) {
+    // Hosts can send more samples than promised in prepareToPlay(), so take the ramps in chunks they can hold.
+    // Nothing read in a chunk can have been written in it either, so a chunk has to be shorter than the
+    // shortest delay time. Longer kernels also read a few samples newer than the delay time.
+    const int maxChunkSize = jlimit(1, mDryWetSmoothed.getMaxBlockSize(), (int) (sampleRate * minDelayTime) - state.delayLineLeft.getLookahead() - 1);
+
+    for (int start = 0; start < numSamplesToProcess; start += maxChunkSize) {
+        const int numSamples = jmin(maxChunkSize, numSamplesToProcess - start);
+
+        const float* dryWet = mDryWetSmoothed.getRamp(numSamples);
+        const float* depth = mDepthSmoothed.getRamp(numSamples);
+        const float* rate = mRateSmoothed.getRamp(numSamples);
+        const float* phaseOffset = mPhaseOffsetSmoothed.getRamp(numSamples);
+        const float* feedback = mFeedbackSmoothed.getRamp(numSamples);
+
+        float* lfoLeft = mLFOBuffer.getWritePointer(0);
+        float* lfoRight = mLFOBuffer.getWritePointer(1);
+        float* voicePhaseOffset = mLFOBuffer.getWritePointer(2);
+
+        SampleType* delayTimeSamplesLeft = state.blockBuffer.getWritePointer(0);
+        SampleType* delayTimeSamplesRight = state.blockBuffer.getWritePointer(1);
+        SampleType* voiceSamples = state.blockBuffer.getWritePointer(2);
+        SampleType* wetLeft = state.blockBuffer.getWritePointer(3);
+        SampleType* wetRight = state.blockBuffer.getWritePointer(4);
+        SampleType* delayInput = state.blockBuffer.getWritePointer(5);
+        bool wroteSound = false;
+
+        // Every voice reads a whole chunk of its delay times in one go, several outputs to a vector,
+        // so extra voices only add a fraction of what the first one costs per sample. These are plain
+        // loops, so they're vectorised for whichever instruction set this CPU has. The LFO and the
+        // parameters stay single precision, but the samples, the delay lines and the feedback are all SampleType.
+        dispatchSIMD([&] {
+            // The lambda sees these by reference, and the compiler can't rule out the loops below writing
+            // over them, which stops the delay time loop vectorising. Copies of its own don't have that problem.
+            const float voiceSampleRate = sampleRate;
+            const float voiceMinDelayTime = minDelayTime;
+            const float voiceMaxDelayTime = maxDelayTime;
+
+            mLFO.advance(rate, numSamples);
+
+            for (int voice = 0; voice < numVoices; voice++) {
+                // Voices are spread evenly around the LFO's cycle, and each one sits a little further back
+                const float voicePhase = (float) voice / (float) numVoices;
+                const float voiceDelayTime = voicePhase * VOICE_DELAY_SPREAD * (voiceMaxDelayTime - voiceMinDelayTime);
+
+                // The R channel also has its own phase offset, and the LFO can only wrap the sum of the two once
+                const float* phaseOffsetRight = phaseOffset;
+
+                if (voice > 0) {
+                    for (int i = 0; i < numSamples; i++) {
+                        const float offset = phaseOffset[i] + voicePhase;
+                        voicePhaseOffset[i] = offset >= 1 ? offset - 1 : offset;
+                    }
+
+                    phaseOffsetRight = voicePhaseOffset;
+                }
+
+                mLFO.getBlock(lfoLeft, voicePhase);
+                mLFO.getBlock(lfoRight, phaseOffsetRight);
+
+                // LFO depth is multiplied by the depth parameter, then mapped to a range of delay times in samples
+                for (int i = 0; i < numSamples; i++) {
+                    delayTimeSamplesLeft[i] = voiceSampleRate * (jmap(lfoLeft[i] * depth[i], -1.0f, 1.0f, voiceMinDelayTime, voiceMaxDelayTime) + voiceDelayTime);
+                    delayTimeSamplesRight[i] = voiceSampleRate * (jmap(lfoRight[i] * depth[i], -1.0f, 1.0f, voiceMinDelayTime, voiceMaxDelayTime) + voiceDelayTime);
+                }
+
+                // The first voice goes straight into the sum, and the rest are added on
+                readVoice(state.delayLineLeft, state.allpassStatesLeft[voice], delayTimeSamplesLeft, voice == 0 ? wetLeft : voiceSamples, numSamples);
+
+                if (voice > 0) {
+                    for (int i = 0; i < numSamples; i++) {
+                        wetLeft[i] += voiceSamples[i];
+                    }
+                }
+
+                readVoice(state.delayLineRight, state.allpassStatesRight[voice], delayTimeSamplesRight, voice == 0 ? wetRight : voiceSamples, numSamples);
+
+                if (voice > 0) {
+                    for (int i = 0; i < numSamples; i++) {
+                        wetRight[i] += voiceSamples[i];
+                    }
+                }
+            }
+
+            // Average the voices, which keeps the feedback loop as stable as with one
+            if (numVoices > 1) {
+                const SampleType voiceGain = (SampleType) 1 / (SampleType) numVoices;
+
+                for (int i = 0; i < numSamples; i++) {
+                    wetLeft[i] *= voiceGain;
+                    wetRight[i] *= voiceGain;
+                }
+            }
+
+            mixChannelBlock(leftChannel + start, wetLeft, delayInput, state.feedbackLeft, feedback, dryWet, numSamples);
+            state.delayLineLeft.pushBlock(delayInput, numSamples);
+            wroteSound = ! isSilent(delayInput, numSamples);
+
+            mixChannelBlock(rightChannel + start, wetRight, delayInput, state.feedbackRight, feedback, dryWet, numSamples);
+            state.delayLineRight.pushBlock(delayInput, numSamples);
+            wroteSound = wroteSound || ! isSilent(delayInput, numSamples);
+        });
+
+        // Capped well past the longest delay, and well short of overflowing
+        state.numSilentSamples = wroteSound ? 0 : jmin(state.numSilentSamples + numSamples, 1 << 30);
+    }
+}
 
-        // Linear interpolation for R channel
-        int readHeadRight_x = (int) delayReadHeadRight;
-        int readHeadRight_x1 = readHeadRight_x + 1;
-        float readHeadFloatRight = delayReadHeadRight - readHeadRight_x;
-        if (readHeadRight_x1 >= mCircularBufferLength) {
-            readHeadRight_x1 -= mCircularBufferLength;
-        }
+float BasicChorusFlangerAudioProcessor::getLongestDelayTime (int type, int numVoices) noexcept {
+    // The last voice sits the furthest back, just short of the whole spread
+    const float minDelayTime = type == 0 ? CHORUS_MIN_DELAY_TIME : FLANGER_MIN_DELAY_TIME;
+    const float maxDelayTime = type == 0 ? CHORUS_MAX_DELAY_TIME : FLANGER_MAX_DELAY_TIME;
+    const float lastVoicePhase = (float) (numVoices - 1) / (float) numVoices;
+
+    return maxDelayTime + lastVoicePhase * VOICE_DELAY_SPREAD * (maxDelayTime - minDelayTime);
+}
 
-        // Generate the actual samples stored in the buffers
-        float delaySampleLeft = lerp(mCircularBufferLeft[readHeadLeft_x], mCircularBufferLeft[readHeadLeft_x1], readHeadFloatLeft);
-        float delaySampleRight = lerp(mCircularBufferRight[readHeadRight_x], mCircularBufferRight[readHeadRight_x1], readHeadFloatRight);
+template <typename SampleType>
+void BasicChorusFlangerAudioProcessor::readVoice (DelayLine<SampleType>& delayLine, SampleType& allpassState, const SampleType* delayTimeInSamples,
+                                                  SampleType* dest, int numSamples) {
+    delayLine.setAllpassState(allpassState);
+    delayLine.readFractionalBlock(delayTimeInSamples, dest, numSamples);
+    allpassState = delayLine.getAllpassState();
+}
 
-        // Feedback is stored so it can be written back in to the circular buffer
-        mFeedbackLeft = *mFeedbackParam * delaySampleLeft;
-        mFeedbackRight = *mFeedbackParam * delaySampleRight;
+template <typename SampleType>
+void BasicChorusFlangerAudioProcessor::mixChannelBlock (SampleType* samples, const SampleType* wet, SampleType* delayInput, SampleType& feedbackState,
+                                                        const float* feedback, const float* dryWet, int numSamples) {
+    // Each sample's feedback goes into the delay line along with the next input sample,
+    // so the input is the dry signal plus the feedback shifted along by one
+    delayInput[0] = samples[0] + feedbackState;
 
-        // Advance the write head
-        mCircularBufferWriteHead++;
-        if (mCircularBufferWriteHead >= mCircularBufferLength) {
-            mCircularBufferWriteHead = 0;
-        }
+    for (int i = 1; i < numSamples; i++) {
+        delayInput[i] = samples[i] + feedback[i - 1] * wet[i - 1];
+    }
 
-        // Write back into the sample with the dry and wet signal
-        float dryAmount = 1 - *mDryWetParam;
-        float wetAmount = *mDryWetParam;
+    feedbackState = feedback[numSamples - 1] * wet[numSamples - 1];
 
-        buffer.setSample(0, i, buffer.getSample(0, i) *  dryAmount + delaySampleLeft * wetAmount);
-        buffer.setSample(1, i, buffer.getSample(1, i) *  dryAmount + delaySampleRight * wetAmount);
+    // Write back into the sample with the dry and wet signal
+    for (int i = 0; i < numSamples; i++) {
+        samples[i] = samples[i] * (1 - (SampleType) dryWet[i]) + wet[i] * dryWet[i];
     }
 }
 
@@ -304,6 +495,11 @@ void BasicChorusFlangerAudioProcessor::getStateInformation (MemoryBlock& destDat
     xml->setAttribute("PhaseOffset", *mPhaseOffsetParam);
     xml->setAttribute("Feedback", *mFeedbackParam);
     xml->setAttribute("Type", *mTypeParam);
+    xml->setAttribute("Shape", *mShapeParam);
+    xml->setAttribute("Interpolation", *mInterpolationParam);
+    xml->setAttribute("Oversampling", *mOversamplingParam);
+    xml->setAttribute("OversampleOfflineOnly", *mOversampleOfflineOnlyParam);
+    xml->setAttribute("Voices", *mVoicesParam);
 
     copyXmlToBinary(*xml, destData);
 }
@@ -316,12 +512,17 @@ void BasicChorusFlangerAudioProcessor::setStateInformation (const void* data, in
 
     if (xml.get() != nullptr && xml->hasTagName("ChorusFlanger")) {
         *mDryWetParam = xml->getDoubleAttribute("DryWet");
-        *mDepthParam = xml->getDoubleAttribute("DryWet");
-        *mRateParam = xml->getDoubleAttribute("DryWet");
+        *mDepthParam = xml->getDoubleAttribute("Depth");
+        *mRateParam = xml->getDoubleAttribute("Rate");
         *mPhaseOffsetParam = xml->getDoubleAttribute("PhaseOffset");
         *mFeedbackParam = xml->getDoubleAttribute("Feedback");
 
         *mTypeParam = xml->getIntAttribute("Type");
+        *mShapeParam = xml->getIntAttribute("Shape", 0);
+        *mInterpolationParam = xml->getIntAttribute("Interpolation", 0);
+        *mOversamplingParam = xml->getIntAttribute("Oversampling", 0);
+        *mOversampleOfflineOnlyParam = xml->getBoolAttribute("OversampleOfflineOnly", true);
+        *mVoicesParam = xml->getIntAttribute("Voices", 1);
     }
 }
 
@@ -330,7 +531,3 @@ void BasicChorusFlangerAudioProcessor::setStateInformation (const void* data, in
 AudioProcessor* JUCE_CALLTYPE createPluginFilter() {
     return new BasicChorusFlangerAudioProcessor();
 }
-
-float BasicChorusFlangerAudioProcessor::lerp(float sampleA, float sampleB, float inPhase) {
-    return (1 - inPhase) * sampleA + inPhase * sampleB;
-}
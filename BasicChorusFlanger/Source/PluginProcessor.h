@@ -1,8 +1,26 @@
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
-
-#define MAX_DELAY_TIME 2
+#include "JuceHeader.h"
+#include "../../Common/Arena.h"
+#include "../../Common/DelayLine.h"
+#include "../../Common/LFO.h"
+#include "../../Common/Oversampler.h"
+#include "../../Common/SmoothedParameter.h"
+#include "../../Common/SIMD.h"
+#include "../../Common/Silence.h"
+
+// Ranges the LFO sweeps the delay time over, in seconds
+#define CHORUS_MIN_DELAY_TIME 0.005f
+#define CHORUS_MAX_DELAY_TIME 0.03f
+#define FLANGER_MIN_DELAY_TIME 0.001f
+#define FLANGER_MAX_DELAY_TIME 0.005f
+
+// Voices per channel. Each one after the first sits further back, by up to half the sweep range.
+#define MAX_VOICES 8
+#define VOICE_DELAY_SPREAD 0.5f
+
+// The delay lines only need to reach the longest of them
+#define MAX_DELAY_TIME (CHORUS_MAX_DELAY_TIME + VOICE_DELAY_SPREAD * (CHORUS_MAX_DELAY_TIME - CHORUS_MIN_DELAY_TIME))
 
 //==============================================================================
 /**
@@ -23,6 +41,8 @@ public:
 #endif
 
     void processBlock (AudioBuffer<float>&, MidiBuffer&) override;
+    void processBlock (AudioBuffer<double>&, MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     AudioProcessorEditor* createEditor() override;
@@ -47,10 +67,67 @@ public:
     void getStateInformation (MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    float lerp(float sampleA, float sampleB, float inPhase);
-
 private:
 
+    /** The delay lines and the feedback going back into them, in one sample type. */
+    template <typename SampleType>
+    struct ChorusState {
+        // Power-of-two sized, so the read and write heads wrap with a mask. Every voice reads the same one.
+        DelayLine<SampleType> delayLineLeft;
+        DelayLine<SampleType> delayLineRight;
+
+        SampleType feedbackLeft = 0;
+        SampleType feedbackRight = 0;
+
+        // Each voice's Thiran allpass, which would otherwise run on from the voice read before it
+        SampleType allpassStatesLeft[MAX_VOICES] = {};
+        SampleType allpassStatesRight[MAX_VOICES] = {};
+
+        // Scratch space, one chunk long: delay times for both channels, one voice's output,
+        // the sum of the voices for both channels, then delay line input
+        ArenaBuffer<SampleType> blockBuffer;
+
+        // Only used when oversampling, to carry each chunk up to the higher rate and back
+        Oversampler<SampleType> oversamplerLeft;
+        Oversampler<SampleType> oversamplerRight;
+        ArenaBuffer<SampleType> oversampledBuffer;
+
+        // How many samples in a row, at the oversampled rate, have gone into the delay lines silent
+        int numSilentSamples = 0;
+
+        bool isPrepared = false;
+    };
+
+    ChorusState<float>& getState (AudioBuffer<float>&) noexcept      { return mFloatState; }
+    ChorusState<double>& getState (AudioBuffer<double>&) noexcept    { return mDoubleState; }
+
+    template <typename SampleType>
+    void prepareState (ChorusState<SampleType>& state, double sampleRate, int samplesPerBlock);
+
+    /** Both processBlock()s share this, so a 64-bit host's blocks are processed as they are rather than converted. */
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& buffer);
+
+    /** Runs the modulated delay over numSamples of both channels, at the oversampled rate if oversampling is on. */
+    template <typename SampleType>
+    void processChunks (ChorusState<SampleType>& state, SampleType* leftChannel, SampleType* rightChannel, int numSamplesToProcess,
+                        float sampleRate, float minDelayTime, float maxDelayTime, int numVoices);
+
+    /** The furthest back any voice reads, in seconds, for the chorus (type 0) or the flanger. */
+    static float getLongestDelayTime (int type, int numVoices) noexcept;
+
+    /** Reads one voice's chunk from a delay line, with the voice's own allpass state. */
+    template <typename SampleType>
+    static void readVoice (DelayLine<SampleType>& delayLine, SampleType& allpassState, const SampleType* delayTimeInSamples,
+                           SampleType* dest, int numSamples);
+
+    /** Works out what goes into one channel's delay line from its dry and wet signals,
+        then mixes the wet signal into the samples.
+     */
+    template <typename SampleType>
+    static void mixChannelBlock (SampleType* samples, const SampleType* wet, SampleType* delayInput, SampleType& feedbackState,
+                                 const float* feedback, const float* dryWet, int numSamples);
+
     // Parameter Declarations
 
     AudioParameterFloat* mDryWetParam;
@@ -59,19 +136,32 @@ private:
     AudioParameterFloat* mPhaseOffsetParam;
     AudioParameterFloat* mFeedbackParam;
     AudioParameterInt* mTypeParam;
-
-    // LFO
-    float mLFOPhase;
-
-    // Circular Buffer
-    float mFeedbackLeft;
-    float mFeedbackRight;
-
-    int mCircularBufferWriteHead;
-    int mCircularBufferLength;
-
-    float* mCircularBufferLeft;
-    float* mCircularBufferRight;
+    AudioParameterInt* mShapeParam;
+    AudioParameterInt* mInterpolationParam;
+    AudioParameterInt* mVoicesParam;
+    AudioParameterInt* mOversamplingParam;
+    AudioParameterBool* mOversampleOfflineOnlyParam;
+
+    // 1, 2 or 4, picked in prepareToPlay() because it changes the latency
+    int mOversamplingFactor = 1;
+
+    // Holds the buffers of everything below, so it's declared first and goes last
+    Arena mArena;
+
+    // Parameters are read once per block and ramped from there
+    SmoothedParameter<float> mDryWetSmoothed { 20.0 };
+    SmoothedParameter<float> mDepthSmoothed { 20.0 };
+    SmoothedParameter<float> mRateSmoothed { 20.0 };
+    SmoothedParameter<float> mPhaseOffsetSmoothed { 20.0 };
+    SmoothedParameter<float> mFeedbackSmoothed { 20.0 };
+
+    // LFO, generated a block at a time into mLFOBuffer, along with the phase offsets for the R channel's voices
+    LFO<float> mLFO;
+    ArenaBuffer<float> mLFOBuffer;
+
+    // Circular buffers, for whichever precision the host asked for
+    ChorusState<float> mFloatState;
+    ChorusState<double> mDoubleState;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BasicChorusFlangerAudioProcessor)
@@ -69,6 +69,25 @@ BasicDelayAudioProcessorEditor::BasicDelayAudioProcessorEditor (BasicDelayAudioP
     mDelayTimeSlider.onDragEnd = [delayParameter] {
         delayParameter->endChangeGesture();
     };
+
+    AudioParameterInt* interpolationParameter = (AudioParameterInt*)params.getUnchecked(3);
+
+    mInterpolation.setBounds(0, 112, 100, 30);
+    mInterpolation.addItem("Linear", 1);
+    mInterpolation.addItem("Hermite", 2);
+    mInterpolation.addItem("Lagrange", 3);
+    mInterpolation.addItem("Thiran", 4);
+    mInterpolation.addItem("Sinc 8", 5);
+    mInterpolation.addItem("Sinc 16", 6);
+    addAndMakeVisible(mInterpolation);
+
+    mInterpolation.onChange = [this, interpolationParameter] {
+        interpolationParameter->beginChangeGesture();
+        *interpolationParameter = mInterpolation.getSelectedItemIndex();
+        interpolationParameter->endChangeGesture();
+    };
+
+    mInterpolation.setSelectedItemIndex(*interpolationParameter);
 }
 
 BasicDelayAudioProcessorEditor::~BasicDelayAudioProcessorEditor() {
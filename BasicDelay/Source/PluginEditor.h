@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include "JuceHeader.h"
 #include "PluginProcessor.h"
 
 //==============================================================================
@@ -27,6 +27,8 @@ private:
     Slider mFeedbackSlider;
     Slider mDelayTimeSlider;
 
+    ComboBox mInterpolation;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BasicDelayAudioProcessorEditor)
 
 };
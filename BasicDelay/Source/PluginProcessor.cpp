@@ -17,30 +17,41 @@ BasicDelayAudioProcessor::BasicDelayAudioProcessor()
     // User-controllable parameters
     addParameter(mDryWetParam = new AudioParameterFloat("drywet", "Dry / Wet", 0.0, 1.0, 0.5));
     addParameter(mFeedbackParam = new AudioParameterFloat("feedback", "Feedback", 0.0, 0.98, 0.5));
-    addParameter(mDelayTimeParam = new AudioParameterFloat("delaytime", "Delay Time", 0.1, MAX_DELAY_TIME, 0.5));
+    addParameter(mDelayTimeParam = new AudioParameterFloat("delaytime", "Delay Time", MIN_DELAY_TIME, MAX_TIME_PARAMETER, 0.5));
+    addParameter(mInterpolationParam = new AudioParameterInt("interpolation", "Interpolation", 0, 5, 0));
+    addParameter(mLowCutParam = new AudioParameterFloat("lowcut", "Low Cut", MIN_LOW_CUT, MAX_LOW_CUT, MIN_LOW_CUT));
+    addParameter(mHighCutParam = new AudioParameterFloat("highcut", "High Cut", MIN_HIGH_CUT, MAX_HIGH_CUT, MAX_HIGH_CUT));
+
+    // The tap table. Tap 1's time is the delay time above, and the others start spread out after it, out of the feedback.
+    addParameter(mTapsParam = new AudioParameterInt("taps", "Taps", 1, MAX_TAPS, 1));
+
+    for (int i = 0; i < MAX_TAPS; i++) {
+        Tap& tap = mTaps[i];
+        const String id = "tap" + String(i + 1);
+        const String name = "Tap " + String(i + 1) + " ";
+
+        if (i == 0) {
+            tap.time = mDelayTimeParam;
+        } else {
+            addParameter(tap.time = new AudioParameterFloat(id + "time", name + "Time", MIN_DELAY_TIME, MAX_TIME_PARAMETER, jmin((float) MAX_TIME_PARAMETER, 0.5f + 0.25f * i)));
+        }
+
+        addParameter(tap.gain = new AudioParameterFloat(id + "gain", name + "Gain", 0.0, 1.0, i == 0 ? 1.0 : 0.5));
+        addParameter(tap.pan = new AudioParameterFloat(id + "pan", name + "Pan", -1.0, 1.0, 0.0));
+        addParameter(tap.feedback = new AudioParameterFloat(id + "feedback", name + "Feedback", 0.0, 1.0, i == 0 ? 1.0 : 0.0));
+        addParameter(tap.cross = new AudioParameterFloat(id + "cross", name + "Cross Feedback", 0.0, 1.0, 0.0));
+    }
 
-    mCircularBufferLeft = nullptr;
-    mCircularBufferRight = nullptr;
-    mCircularBufferWriteHead = 0;
-    mCircularBufferLength = 0;
-    mDelayTimeInSamples = 0;
-    mDelayReadHead = 0;
-    mDelayTimeSmoothed = 0;
+    // Last, so the parameters before them keep their indices. The maximum's knob puts two seconds half way round.
+    NormalisableRange<float> maxDelayRange(MIN_DELAY_TIME, MAX_DELAY_TIME);
+    maxDelayRange.setSkewForCentre(DEFAULT_MAX_DELAY_TIME);
 
-    mFeedbackLeft = 0;
-    mFeedbackRight = 0;
+    addParameter(mMaxDelayParam = new AudioParameterFloat("maxdelay", "Max Delay Time", maxDelayRange, DEFAULT_MAX_DELAY_TIME));
+    addParameter(mTimeRangeParam = new AudioParameterInt("timerange", "Time Range", 0, 2, 0));
 }
 
 BasicDelayAudioProcessor::~BasicDelayAudioProcessor() {
-    if (mCircularBufferLeft != nullptr) {
-        delete [] mCircularBufferLeft;
-        mCircularBufferLeft = nullptr;
-    }
-
-    if (mCircularBufferRight != nullptr) {
-        delete [] mCircularBufferRight;
-        mCircularBufferRight = nullptr;
-    }
+    mPagingThread->removeTimeSliceClient(this);
 }
 
 //==============================================================================
@@ -73,7 +84,25 @@ bool BasicDelayAudioProcessor::isMidiEffect() const {
 }
 
 double BasicDelayAudioProcessor::getTailLengthSeconds() const {
-    return 0.0;
+    // Each time round, the repeats come back at the feedback times the taps' feedback, which is
+    // scaled down to 1 in all. The longest tap that feeds back sets how long a trip round takes,
+    // and the longest of all how long the last repeat takes to come out.
+    const int numTaps = mTapsParam->get();
+    float totalTapFeedback = 0;
+    float longestFeedbackTime = 0;
+    float longestTime = 0;
+
+    for (int i = 0; i < numTaps; i++) {
+        const float time = getTapTime(mTaps[i]);
+        longestTime = jmax(longestTime, time);
+
+        if (mTaps[i].feedback->get() > 0) {
+            totalTapFeedback += mTaps[i].feedback->get();
+            longestFeedbackTime = jmax(longestFeedbackTime, time);
+        }
+    }
+
+    return getFeedbackTailSeconds(mFeedbackParam->get() * jmin(1.0f, totalTapFeedback), longestFeedbackTime, longestTime);
 }
 
 int BasicDelayAudioProcessor::getNumPrograms() {
@@ -99,27 +128,113 @@ void BasicDelayAudioProcessor::changeProgramName (int index, const String& newNa
 
 //==============================================================================
 void BasicDelayAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock) {
-    mCircularBufferLength = sampleRate * MAX_DELAY_TIME;
-    mDelayTimeInSamples = sampleRate * *mDelayTimeParam; // delayTimeLength
+    // The paging thread mustn't touch the delay lines while they're replaced
+    mPagingThread->removeTimeSliceClient(this);
+
+    mArena.build([this, sampleRate, samplesPerBlock] {
+        // Paged delay lines can hold the longest delay of all, since they only pay for what's in reach
+        mLongestDelayTime = mDelayStorage == DelayStorage::interleaved ? mMaxDelayParam->get() : (float) MAX_DELAY_TIME;
+
+        mDryWetSmoothed.prepare(sampleRate, samplesPerBlock);
+        mFeedbackSmoothed.prepare(sampleRate, samplesPerBlock);
+        mTapFeedbackScaleSmoothed.prepare(sampleRate, samplesPerBlock);
+
+        mDryWetSmoothed.setCurrentAndTargetValue(*mDryWetParam);
+        mFeedbackSmoothed.setCurrentAndTargetValue(*mFeedbackParam);
+        mTapFeedbackScaleSmoothed.setCurrentAndTargetValue(1.0f);
+
+        for (auto& tap : mTaps) {
+            tap.timeSmoothed.prepare(sampleRate, samplesPerBlock);
+            tap.gainSmoothed.prepare(sampleRate, samplesPerBlock);
+            tap.panSmoothed.prepare(sampleRate, samplesPerBlock);
+            tap.feedbackSmoothed.prepare(sampleRate, samplesPerBlock);
+            tap.crossSmoothed.prepare(sampleRate, samplesPerBlock);
+
+            tap.timeSmoothed.setCurrentAndTargetValue(getTapTime(tap) * sampleRate);
+            tap.gainSmoothed.setCurrentAndTargetValue(*tap.gain);
+            tap.panSmoothed.setCurrentAndTargetValue(*tap.pan);
+            tap.feedbackSmoothed.setCurrentAndTargetValue(*tap.feedback);
+            tap.crossSmoothed.setCurrentAndTargetValue(*tap.cross);
+        }
+
+        // Seconds of doubles per channel is a lot to keep around unused, so the other precision's state is freed
+        if (isUsingDoublePrecision()) {
+            prepareState(mDoubleState, sampleRate, samplesPerBlock);
+            mFloatState = DelayState<float>();
+        } else {
+            prepareState(mFloatState, sampleRate, samplesPerBlock);
+            mDoubleState = DelayState<double>();
+        }
+    });
+
+    // The spares are only allocated once the arena has settled on its last pass, and before the first block
+    servicePages(mFloatState);
+    servicePages(mDoubleState);
+
+    mPagingThread->addTimeSliceClient(this);
+}
+
+template <typename SampleType>
+void BasicDelayAudioProcessor::prepareState (DelayState<SampleType>& state, double sampleRate, int samplesPerBlock) {
+    // A delay line for every channel, with room for the longest delay time. Clears any garbage left from last time.
+    const int numChannels = getTotalNumInputChannels();
+    const int numPairs = mDelayStorage == DelayStorage::interleaved ? numChannels / 2 : 0;
 
-    if (mCircularBufferLeft == nullptr) {
-        delete [] mCircularBufferLeft;
-        mCircularBufferLeft = new float[mCircularBufferLength];
+    state.stereoDelayLines = ArenaVector<InterleavedDelayLine<SampleType, 2>>((size_t) numPairs);
+    state.delayLines = ArenaVector<DelayLine<SampleType>>((size_t) (numChannels - 2 * numPairs));
+    state.feedback = ArenaVector<SampleType>((size_t) numChannels, SampleType());
+    state.allpassStates = ArenaVector<SampleType>((size_t) (MAX_TAPS * numChannels), SampleType());
+
+    for (auto& delayLine : state.stereoDelayLines) {
+        delayLine.prepare(sampleRate * mLongestDelayTime);
     }
 
-    // Clear the buffers after instantiating!
-    zeromem(mCircularBufferLeft, mCircularBufferLength * sizeof(float));
+    // Only the page tables and a few spare pages are allocated up front, so even five minutes' worth starts straight away
+    const auto storage = mDelayStorage == DelayStorage::compact ? DelayLine<SampleType>::Storage::int16
+                                                                : DelayLine<SampleType>::Storage::paged;
+
+    // The spares have to last a block, and ten of the paging thread's rounds in case it's held up
+    const int maxPushesBetweenServices = samplesPerBlock + (int) std::ceil(sampleRate * PAGING_INTERVAL_MS * 0.01);
 
-    if (mCircularBufferRight == nullptr) {
-        delete [] mCircularBufferRight;
-        mCircularBufferRight = new float[mCircularBufferLength];
+    for (size_t channel = 0; channel < state.delayLines.size(); channel++) {
+        state.delayLines[channel].prepare(sampleRate * mLongestDelayTime, 1, storage, maxPushesBetweenServices);
+        state.delayLines[channel].setDitherSeed((uint32_t) channel);
     }
 
-    // Clear the buffers after instantiating!
-    zeromem(mCircularBufferRight, mCircularBufferLength * sizeof(float));
+    // Feedback filters for every four channels. Their coefficients are worked out on the first block.
+    state.feedbackFilters = ArenaVector<Biquad<SampleType, 4, 2>>((size_t) (numChannels + 3) / 4, Biquad<SampleType, 4, 2>());
+    state.lowCutFrequency = 0;
+    state.highCutFrequency = 0;
+
+    state.blockBuffer.setSize(2 + 5 * 4, mDryWetSmoothed.getMaxBlockSize());
+    state.numSilentSamples = 0;
+}
+
+float BasicDelayAudioProcessor::getMaxDelayTime() const noexcept {
+    return jmin(mMaxDelayParam->get(), mLongestDelayTime);
+}
+
+float BasicDelayAudioProcessor::getTapTime (const Tap& tap) const noexcept {
+    // 0.1 - 2, 1 - 20 or 15 - 300 seconds
+    static const float timeRangeScales[] = { 1.0f, 10.0f, 150.0f };
 
-    mCircularBufferWriteHead = 0;
-    mDelayTimeSmoothed = *mDelayTimeParam;
+    return jmin(tap.time->get() * timeRangeScales[mTimeRangeParam->get()], getMaxDelayTime());
+}
+
+template <typename SampleType>
+void BasicDelayAudioProcessor::servicePages (DelayState<SampleType>& state) {
+    for (auto& delayLine : state.delayLines) {
+        delayLine.servicePages();
+    }
+}
+
+int BasicDelayAudioProcessor::useTimeSlice() {
+    // Only one of the states has any delay lines
+    servicePages(mFloatState);
+    servicePages(mDoubleState);
+
+    // The spares last the write head ten times this long
+    return PAGING_INTERVAL_MS;
 }
 
 void BasicDelayAudioProcessor::releaseResources() {
@@ -133,10 +248,8 @@ bool BasicDelayAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
     ignoreUnused (layouts);
     return true;
 #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    if (layouts.getMainOutputChannelSet() != AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != AudioChannelSet::stereo())
+    // Every channel gets its own delay line, so anything from mono to surround and ambisonic beds will do
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -152,6 +265,19 @@ bool BasicDelayAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 #endif
 
 void BasicDelayAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages) {
+    process(buffer);
+}
+
+void BasicDelayAudioProcessor::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midiMessages) {
+    process(buffer);
+}
+
+bool BasicDelayAudioProcessor::supportsDoublePrecisionProcessing() const {
+    return true;
+}
+
+template <typename SampleType>
+void BasicDelayAudioProcessor::process (AudioBuffer<SampleType>& buffer) {
     ScopedNoDenormals noDenormals;
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -166,51 +292,449 @@ void BasicDelayAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuf
         buffer.clear (i, 0, buffer.getNumSamples());
     }
 
-    float* leftChannel = buffer.getWritePointer(0);
-    float* rightChannel = buffer.getWritePointer(1);
+    SampleType* const* channels = buffer.getArrayOfWritePointers();
+    auto& state = getState(buffer);
+
+    // Hosts can change the layout without preparing again, so only go as far as the delay lines we have.
+    // That's none at all if this precision wasn't the one prepared for, which leaves the dry signal.
+    const int numPairs = jmin(totalNumInputChannels / 2, (int) state.stereoDelayLines.size());
+    const int firstPlanarChannel = 2 * (int) state.stereoDelayLines.size();
+    const int numChannels = jmin(totalNumInputChannels, firstPlanarChannel + (int) state.delayLines.size());
+
+    if (numChannels == 0) {
+        return;
+    }
+
+    // Take one snapshot of the parameters per block, so the loop below only works on plain floats
+    mDryWetSmoothed.setTargetValue(*mDryWetParam);
+    mFeedbackSmoothed.setTargetValue(*mFeedbackParam);
+
+    // Offline, blocks can come faster than the paging thread keeps up with, but taking time is fine
+    if (isNonRealtime()) {
+        servicePages(state);
+    }
+
+    // Taps that are off jump straight to their settings, so they don't glide in from old ones when they come back on.
+    // None of them reach further back than the delay lines keep.
+    const int numTaps = *mTapsParam;
+    const float maxDelayTime = getMaxDelayTime();
+    float totalTapFeedback = 0;
+    float totalTapGain = 0;
+    double longestTapDelay = 0;
+
+    for (int i = 0; i < MAX_TAPS; i++) {
+        Tap& tap = mTaps[i];
+
+        if (i < numTaps) {
+            tap.timeSmoothed.setTargetValue(getTapTime(tap) * getSampleRate());
+            tap.gainSmoothed.setTargetValue(*tap.gain);
+            tap.panSmoothed.setTargetValue(*tap.pan);
+            tap.feedbackSmoothed.setTargetValue(*tap.feedback);
+            tap.crossSmoothed.setTargetValue(*tap.cross);
+            totalTapFeedback += tap.feedbackSmoothed.getTargetValue();
+            totalTapGain += jmax(tap.gainSmoothed.getCurrentValue(), tap.gainSmoothed.getTargetValue());
+            longestTapDelay = jmax(longestTapDelay, tap.timeSmoothed.getCurrentValue(), tap.timeSmoothed.getTargetValue());
+        } else {
+            tap.timeSmoothed.setCurrentAndTargetValue(getTapTime(tap) * getSampleRate());
+            tap.gainSmoothed.setCurrentAndTargetValue(*tap.gain);
+            tap.panSmoothed.setCurrentAndTargetValue(*tap.pan);
+            tap.feedbackSmoothed.setCurrentAndTargetValue(*tap.feedback);
+            tap.crossSmoothed.setCurrentAndTargetValue(*tap.cross);
+        }
+    }
+
+    mTapFeedbackScaleSmoothed.setTargetValue(1.0f / jmax(1.0f, totalTapFeedback));
+    const bool singleTap = isSingleTap(numTaps);
+
+    const SampleType sampleRate = (SampleType) getSampleRate();
+
+    // Switching kernels is cheap, so it can follow the parameter every block
+    const auto interpolation = (Interpolation) (int) *mInterpolationParam;
+
+    for (auto& delayLine : state.stereoDelayLines) {
+        delayLine.setInterpolation(interpolation);
+    }
+
+    for (auto& delayLine : state.delayLines) {
+        delayLine.setInterpolation(interpolation);
+        delayLine.setReach((int) std::ceil(maxDelayTime * sampleRate));
+    }
+
+    // The delay lines drop their allpass state when the kernel changes, so the other taps do too
+    if (interpolation != state.interpolation) {
+        std::fill(state.allpassStates.begin(), state.allpassStates.end(), SampleType());
+        state.interpolation = interpolation;
+    }
+
+    // Once everything the taps can reach, kernels included, went into the delay lines silent, and
+    // the input still is, the delay has nothing to add and the block is left as it is. The delay
+    // lines still move on by a block of silence, so a tap moved further back later on finds the
+    // silence that would have been written there, not what came before it.
+    const int reach = (int) std::ceil(longestTapDelay) + SincInterpolator<SampleType, 16>::numTaps;
+
+    // Every tap can read the same silence at once, so up to 16 of them at full gain add up to 24 dB
+    // more than any one. What's written only counts as silent below silenceLevel by that much less.
+    const SampleType silenceThreshold = (SampleType) (silenceLevel / jmax(1.0f, totalTapGain));
+
+    if (state.numSilentSamples >= reach) {
+        bool inputIsSilent = true;
+
+        dispatchSIMD([&] {
+            for (int channel = 0; channel < numChannels && inputIsSilent; channel++) {
+                inputIsSilent = isSilent(channels[channel], buffer.getNumSamples(), silenceThreshold);
+            }
+        });
+
+        if (inputIsSilent) {
+            skipBlock(state, buffer.getNumSamples());
+            return;
+        }
+    }
+
+    updateFeedbackFilters(state, getSampleRate());
 
-    for (int i = 0; i < buffer.getNumSamples(); i++) {
-        // Smooth the delay time to get the analog warbly effect when turning the Time knob
-        mDelayTimeSmoothed = mDelayTimeSmoothed - 0.001 * (mDelayTimeSmoothed - *mDelayTimeParam);
-        mDelayTimeInSamples = getSampleRate() * mDelayTimeSmoothed;
+    // Nothing read in a chunk can have been written in it, so a chunk has to be shorter than the
+    // shortest delay time. Longer kernels also read a few samples newer than the delay time.
+    const int lookahead = getInterpolationLookahead(interpolation);
+    const int maxChunkSize = jmin(mDryWetSmoothed.getMaxBlockSize(), (int) (sampleRate * MIN_DELAY_TIME) - lookahead - 1);
 
-        mCircularBufferLeft[mCircularBufferWriteHead] = leftChannel[i] + mFeedbackLeft;
-        mCircularBufferRight[mCircularBufferWriteHead] = rightChannel[i] + mFeedbackRight;
+    for (int start = 0; start < buffer.getNumSamples(); start += maxChunkSize) {
+        const int numSamples = jmin(maxChunkSize, buffer.getNumSamples() - start);
 
-        mDelayReadHead = mCircularBufferWriteHead - mDelayTimeInSamples;
+        const float* dryWet = mDryWetSmoothed.getRamp(numSamples);
+        const float* feedback = mFeedbackSmoothed.getRamp(numSamples);
+        TapRamps ramps;
 
-        if (mDelayReadHead < 0) {
-            mDelayReadHead += mCircularBufferLength;
+        for (int i = 0; i < numTaps; i++) {
+            ramps.time[i] = mTaps[i].timeSmoothed.getRamp(numSamples);
+            ramps.gain[i] = mTaps[i].gainSmoothed.getRamp(numSamples);
+            ramps.pan[i] = mTaps[i].panSmoothed.getRamp(numSamples);
+            ramps.feedback[i] = mTaps[i].feedbackSmoothed.getRamp(numSamples);
+            ramps.cross[i] = mTaps[i].crossSmoothed.getRamp(numSamples);
         }
 
-        int readHeadX = (int) mDelayReadHead;
-        int readHeadX1 = readHeadX + 1;
+        ramps.feedbackScale = mTapFeedbackScaleSmoothed.getRamp(numSamples);
+        const double* delayTime = ramps.time[0];
+
+        // Every channel reads from the same position, so the delay times and dry gains are worked
+        // out once and shared. Then each channel's whole chunk is read, mixed and written back with
+        // vector operations, compiled for whichever instruction set this CPU has. The parameter
+        // ramps stay single precision, but everything in the signal path is SampleType.
+        SampleType* delayTimeInSamples = state.blockBuffer.getWritePointer(0);
+        SampleType* dryGain = state.blockBuffer.getWritePointer(1);
+        bool wroteSound = false;
+
+        dispatchSIMD([&] {
+            for (int i = 0; i < numSamples; i++) {
+                delayTimeInSamples[i] = (SampleType) delayTime[i];
+                dryGain[i] = 1 - (SampleType) dryWet[i];
+            }
+
+            // Channels go four at a time, so each filter runs on all four of them at once. A pair
+            // of interleaved channels always lands in the same four.
+            for (int group = 0; group < numChannels; group += 4) {
+                const int groupEnd = jmin(group + 4, numChannels);
+                SampleType* delayed[4];
+                SampleType* filtered[4];
+                SampleType* delayInput[4];
+                SampleType* tapFeedback[4];
+
+                for (int lane = 0; lane < 4; lane++) {
+                    delayed[lane] = state.blockBuffer.getWritePointer(2 + lane);
+                    filtered[lane] = state.blockBuffer.getWritePointer(6 + lane);
+                    delayInput[lane] = state.blockBuffer.getWritePointer(10 + lane);
+                    tapFeedback[lane] = state.blockBuffer.getWritePointer(18 + lane);
+                }
+
+                // A single tap is read straight into delayed. Several are summed into delayed and tapFeedback.
+                if (singleTap) {
+                    for (int lane = 0; lane < 4; lane++) {
+                        const int channel = group + lane;
+
+                        if (channel < 2 * numPairs) {
+                            // Both channels' taps come out of the same frames
+                            if (channel % 2 == 0) {
+                                readDelayLine(state.stereoDelayLines[(size_t) (channel / 2)], delayTimeInSamples, delayed + lane, numSamples);
+                            }
+                        } else if (channel >= firstPlanarChannel && channel < groupEnd) {
+                            readDelayLine(state.delayLines[(size_t) (channel - firstPlanarChannel)], delayTimeInSamples, delayed[lane], numSamples);
+                        } else {
+                            // Lanes without a channel go through the filters as silence
+                            std::fill(delayed[lane], delayed[lane] + numSamples, SampleType());
+                        }
+                    }
+                } else {
+                    readTaps(state, ramps, numTaps, group, numChannels, numPairs, numSamples);
+                }
+
+                // Only what goes back round the loop is filtered
+                SampleType* const* feedbackSignal = singleTap ? delayed : tapFeedback;
+
+                if (state.lowCutFrequency > 0 || state.highCutFrequency > 0) {
+                    state.feedbackFilters[(size_t) (group / 4)].process(feedbackSignal, filtered, numSamples);
+                    feedbackSignal = filtered;
+                }
+
+                for (int channel = group; channel < groupEnd; channel++) {
+                    const int lane = channel - group;
+
+                    if (channel < 2 * numPairs || channel >= firstPlanarChannel) {
+                        mixChannelBlock(channels[channel] + start, delayed[lane], feedbackSignal[lane], delayInput[lane],
+                                        state.feedback[(size_t) channel], feedback, dryWet, dryGain, numSamples);
+                        wroteSound = wroteSound || ! isSilent(delayInput[lane], numSamples, silenceThreshold);
+                    }
+
+                    if (channel < 2 * numPairs) {
+                        if (channel % 2 == 1) {
+                            state.stereoDelayLines[(size_t) (channel / 2)].pushBlock(delayInput + lane - 1, numSamples);
+                        }
+                    } else if (channel >= firstPlanarChannel) {
+                        state.delayLines[(size_t) (channel - firstPlanarChannel)].pushBlock(delayInput[lane], numSamples);
+                    }
+                }
+            }
+        });
+
+        // Capped well past the longest delay, and well short of overflowing
+        state.numSilentSamples = wroteSound ? 0 : jmin(state.numSilentSamples + numSamples, 1 << 30);
+    }
+}
+
+template <typename SampleType>
+void BasicDelayAudioProcessor::updateFeedbackFilters (DelayState<SampleType>& state, double sampleRate) {
+    // At the open end of its range a filter is switched off, and leaves the repeats untouched
+    const float lowCut = *mLowCutParam > MIN_LOW_CUT ? (float) *mLowCutParam : 0.0f;
+    const float highCut = *mHighCutParam < MAX_HIGH_CUT ? (float) *mHighCutParam : 0.0f;
+
+    if (lowCut == state.lowCutFrequency && highCut == state.highCutFrequency) {
+        return;
+    }
+
+    // A filter that's off passes the signal straight through. While both are off, they're skipped
+    // altogether, so whatever they held from before then is stale.
+    using Coefficients = typename Biquad<SampleType, 4, 2>::Coefficients;
 
-        // Extract the decimal value from mDelayReadHead
-        float readHeadFloat = mDelayReadHead - readHeadX;
+    const bool wasOff = state.lowCutFrequency == 0 && state.highCutFrequency == 0;
+    const auto lowCutCoefficients = lowCut > 0 ? Biquad<SampleType, 4, 2>::makeLowCut(sampleRate, lowCut) : Coefficients();
+    const auto highCutCoefficients = highCut > 0 ? Biquad<SampleType, 4, 2>::makeHighCut(sampleRate, highCut) : Coefficients();
 
-        if (readHeadX1 >= mCircularBufferLength) {
-            readHeadX1 -= mCircularBufferLength;
+    for (auto& filter : state.feedbackFilters) {
+        if (wasOff) {
+            filter.reset();
         }
 
-        float delaySampleLeft = lerp(mCircularBufferLeft[readHeadX], mCircularBufferLeft[readHeadX1], readHeadFloat);
-        float delaySampleRight = lerp(mCircularBufferRight[readHeadX], mCircularBufferRight[readHeadX1], readHeadFloat);
+        filter.setCoefficients(0, lowCutCoefficients);
+        filter.setCoefficients(1, highCutCoefficients);
+    }
+
+    state.lowCutFrequency = lowCut;
+    state.highCutFrequency = highCut;
+}
+
+template <typename DelayLineType, typename SampleType, typename Destination>
+void BasicDelayAudioProcessor::readDelayLine (DelayLineType& delayLine, const SampleType* delayTimeInSamples, Destination dest, int numSamples) {
+    // Ramps head one way, so equal ends mean a settled delay time, which reads one straight run of the delay line
+    if (delayTimeInSamples[0] == delayTimeInSamples[numSamples - 1]) {
+        delayLine.readFractionalBlock(delayTimeInSamples[0], dest, numSamples);
+    } else {
+        delayLine.readFractionalBlock(delayTimeInSamples, dest, numSamples);
+    }
+}
 
-        mFeedbackLeft = *mFeedbackParam * delaySampleLeft;
-        mFeedbackRight = *mFeedbackParam * delaySampleRight;
+template <typename SampleType>
+void BasicDelayAudioProcessor::readTaps (DelayState<SampleType>& state, const TapRamps& ramps, int numTaps, int group,
+                                         int numChannels, int numPairs, int numSamples) {
+    const int firstPlanarChannel = 2 * (int) state.stereoDelayLines.size();
+    const int numStates = (int) state.feedback.size();
+
+    SampleType* wet[4];
+    SampleType* tapFeedback[4];
+    SampleType* tapSamples[4];
+
+    for (int lane = 0; lane < 4; lane++) {
+        wet[lane] = state.blockBuffer.getWritePointer(2 + lane);
+        tapSamples[lane] = state.blockBuffer.getWritePointer(14 + lane);
+        tapFeedback[lane] = state.blockBuffer.getWritePointer(18 + lane);
+
+        // Lanes without a channel go through the filters as silence
+        std::fill(wet[lane], wet[lane] + numSamples, SampleType());
+        std::fill(tapFeedback[lane], tapFeedback[lane] + numSamples, SampleType());
+    }
 
-        mCircularBufferWriteHead++;
+    SampleType* delayTimeInSamples = state.blockBuffer.getWritePointer(0);
 
-        // Write back into the sample with the half-second delayed signal
-        buffer.setSample(0, i, buffer.getSample(0, i) *  (1 - *mDryWetParam) + delaySampleLeft * *mDryWetParam);
-        buffer.setSample(1, i, buffer.getSample(1, i) *  (1 - *mDryWetParam) + delaySampleRight * *mDryWetParam);
+    auto hasDelayLine = [&] (int channel) {
+        return channel < 2 * numPairs || (channel >= firstPlanarChannel && channel < numChannels);
+    };
 
-        if (mCircularBufferWriteHead >= mCircularBufferLength) {
-            mCircularBufferWriteHead = 0;
+    // Each tap reads a whole chunk from every channel, then the sums pick it up with vector operations
+    for (int tap = 0; tap < numTaps; tap++) {
+        const double* time = ramps.time[tap];
+        const float* gain = ramps.gain[tap];
+        const float* pan = ramps.pan[tap];
+        const float* feedback = ramps.feedback[tap];
+        const float* cross = ramps.cross[tap];
+        const float* feedbackScale = ramps.feedbackScale;
+
+        for (int i = 0; i < numSamples; i++) {
+            delayTimeInSamples[i] = (SampleType) time[i];
+        }
+
+        for (int lane = 0; lane < 4; lane++) {
+            const int channel = group + lane;
+            SampleType* allpassStates = tap > 0 ? state.allpassStates.data() + tap * numStates + channel : nullptr;
+
+            if (channel < 2 * numPairs) {
+                if (channel % 2 == 0) {
+                    readTap(state.stereoDelayLines[(size_t) (channel / 2)], allpassStates, delayTimeInSamples, tapSamples + lane, numSamples);
+                }
+            } else if (hasDelayLine(channel)) {
+                readTap(state.delayLines[(size_t) (channel - firstPlanarChannel)], allpassStates, delayTimeInSamples, tapSamples[lane], numSamples);
+            }
+        }
+
+        for (int lane = 0; lane < 4; lane++) {
+            const int channel = group + lane;
+            const int partner = channel ^ 1;
+
+            if (! hasDelayLine(channel)) {
+                continue;
+            }
+
+            const SampleType* samples = tapSamples[lane];
+            SampleType* wetSum = wet[lane];
+            SampleType* feedbackSum = tapFeedback[lane];
+
+            // Two loops, since one writing both sums has too many arrays for the compiler to
+            // check for overlaps, and it gives up on vectorising it
+            if (hasDelayLine(partner)) {
+                const SampleType* partnerSamples = tapSamples[partner - group];
+
+                // Balance rather than a pan law, so a centred tap keeps full level on both sides
+                if (channel % 2 == 0) {
+                    for (int i = 0; i < numSamples; i++) {
+                        wetSum[i] += gain[i] * (pan[i] > 0 ? 1 - pan[i] : 1.0f) * samples[i];
+                    }
+                } else {
+                    for (int i = 0; i < numSamples; i++) {
+                        wetSum[i] += gain[i] * (pan[i] < 0 ? 1 + pan[i] : 1.0f) * samples[i];
+                    }
+                }
+
+                for (int i = 0; i < numSamples; i++) {
+                    const SampleType send = feedback[i] * feedbackScale[i];
+                    feedbackSum[i] += send * (1 - cross[i]) * samples[i] + send * cross[i] * partnerSamples[i];
+                }
+            } else {
+                // A channel on its own has nowhere to pan or cross to
+                for (int i = 0; i < numSamples; i++) {
+                    wetSum[i] += gain[i] * samples[i];
+                }
+
+                for (int i = 0; i < numSamples; i++) {
+                    feedbackSum[i] += feedback[i] * feedbackScale[i] * samples[i];
+                }
+            }
         }
     }
 }
 
+template <typename SampleType>
+void BasicDelayAudioProcessor::readTap (DelayLine<SampleType>& delayLine, SampleType* allpassState,
+                                        const SampleType* delayTimeInSamples, SampleType* dest, int numSamples) {
+    if (allpassState == nullptr) {
+        readDelayLine(delayLine, delayTimeInSamples, dest, numSamples);
+        return;
+    }
+
+    const SampleType mainState = delayLine.getAllpassState();
+
+    delayLine.setAllpassState(*allpassState);
+    readDelayLine(delayLine, delayTimeInSamples, dest, numSamples);
+    *allpassState = delayLine.getAllpassState();
+    delayLine.setAllpassState(mainState);
+}
+
+template <typename SampleType>
+void BasicDelayAudioProcessor::readTap (InterleavedDelayLine<SampleType, 2>& delayLine, SampleType* allpassStates,
+                                        const SampleType* delayTimeInSamples, SampleType* const* dest, int numSamples) {
+    if (allpassStates == nullptr) {
+        readDelayLine(delayLine, delayTimeInSamples, dest, numSamples);
+        return;
+    }
+
+    const SampleType mainStates[] = { delayLine.getAllpassState(0), delayLine.getAllpassState(1) };
+
+    for (int channel = 0; channel < 2; channel++) {
+        delayLine.setAllpassState(channel, allpassStates[channel]);
+    }
+
+    readDelayLine(delayLine, delayTimeInSamples, dest, numSamples);
+
+    for (int channel = 0; channel < 2; channel++) {
+        allpassStates[channel] = delayLine.getAllpassState(channel);
+        delayLine.setAllpassState(channel, mainStates[channel]);
+    }
+}
+
+bool BasicDelayAudioProcessor::isSingleTap (int numTaps) const noexcept {
+    const Tap& tap = mTaps[0];
+
+    return numTaps == 1
+        && ! tap.gainSmoothed.isSmoothing() && tap.gainSmoothed.getCurrentValue() == 1
+        && ! tap.panSmoothed.isSmoothing() && tap.panSmoothed.getCurrentValue() == 0
+        && ! tap.feedbackSmoothed.isSmoothing() && tap.feedbackSmoothed.getCurrentValue() == 1
+        && ! tap.crossSmoothed.isSmoothing() && tap.crossSmoothed.getCurrentValue() == 0;
+}
+
+template <typename SampleType>
+void BasicDelayAudioProcessor::skipBlock (DelayState<SampleType>& state, int numSamples) noexcept {
+    for (auto& delayLine : state.stereoDelayLines) {
+        delayLine.advance(numSamples);
+    }
+
+    for (auto& delayLine : state.delayLines) {
+        delayLine.advance(numSamples);
+    }
+
+    // What's carried over from the last block processed has died away along with the rest
+    std::fill(state.feedback.begin(), state.feedback.end(), SampleType());
+    std::fill(state.allpassStates.begin(), state.allpassStates.end(), SampleType());
+    state.numSilentSamples = jmin(state.numSilentSamples + numSamples, 1 << 30);
+
+    mDryWetSmoothed.skip(numSamples);
+    mFeedbackSmoothed.skip(numSamples);
+    mTapFeedbackScaleSmoothed.skip(numSamples);
+
+    for (auto& tap : mTaps) {
+        tap.timeSmoothed.skip(numSamples);
+        tap.gainSmoothed.skip(numSamples);
+        tap.panSmoothed.skip(numSamples);
+        tap.feedbackSmoothed.skip(numSamples);
+        tap.crossSmoothed.skip(numSamples);
+    }
+}
+
+template <typename SampleType>
+void BasicDelayAudioProcessor::mixChannelBlock (SampleType* samples, const SampleType* delayed, const SampleType* feedbackSignal,
+                                                SampleType* delayInput, SampleType& feedbackState,
+                                                const float* feedback, const float* dryWet, const SampleType* dryGain, int numSamples) {
+    // Each sample's feedback goes into the delay line along with the next input sample,
+    // so the input is the dry signal plus the feedback shifted along by one
+    delayInput[0] = samples[0] + feedbackState;
+
+    for (int i = 1; i < numSamples; i++) {
+        delayInput[i] = samples[i] + feedback[i - 1] * feedbackSignal[i - 1];
+    }
+
+    feedbackState = feedback[numSamples - 1] * feedbackSignal[numSamples - 1];
+
+    // Write back into the samples with the delayed signal
+    for (int i = 0; i < numSamples; i++) {
+        samples[i] = samples[i] * dryGain[i] + delayed[i] * dryWet[i];
+    }
+}
+
 //==============================================================================
 bool BasicDelayAudioProcessor::hasEditor() const {
     return true; // (change this to false if you choose to not supply an editor)
@@ -225,11 +749,69 @@ void BasicDelayAudioProcessor::getStateInformation (MemoryBlock& destData) {
     // You should use this method to store your parameters in the memory block.
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
+
+    std::unique_ptr<XmlElement> xml(new XmlElement("Delay"));
+
+    xml->setAttribute("DryWet", *mDryWetParam);
+    xml->setAttribute("Feedback", *mFeedbackParam);
+    xml->setAttribute("DelayTime", *mDelayTimeParam);
+    xml->setAttribute("Interpolation", *mInterpolationParam);
+    xml->setAttribute("LowCut", *mLowCutParam);
+    xml->setAttribute("HighCut", *mHighCutParam);
+    xml->setAttribute("MaxDelay", *mMaxDelayParam);
+    xml->setAttribute("TimeRange", *mTimeRangeParam);
+    xml->setAttribute("Taps", *mTapsParam);
+
+    // Tap 1's time is the delay time above
+    for (int i = 0; i < MAX_TAPS; i++) {
+        const Tap& tap = mTaps[i];
+        const String prefix = "Tap" + String(i + 1);
+
+        if (i > 0) {
+            xml->setAttribute(prefix + "Time", *tap.time);
+        }
+
+        xml->setAttribute(prefix + "Gain", *tap.gain);
+        xml->setAttribute(prefix + "Pan", *tap.pan);
+        xml->setAttribute(prefix + "Feedback", *tap.feedback);
+        xml->setAttribute(prefix + "Cross", *tap.cross);
+    }
+
+    copyXmlToBinary(*xml, destData);
 }
 
 void BasicDelayAudioProcessor::setStateInformation (const void* data, int sizeInBytes) {
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
+
+    std::unique_ptr<XmlElement> xml(getXmlFromBinary(data, sizeInBytes));
+
+    // Anything missing is set to its default, as a new instance would have it
+    if (xml.get() != nullptr && xml->hasTagName("Delay")) {
+        *mDryWetParam = xml->getDoubleAttribute("DryWet", 0.5);
+        *mFeedbackParam = xml->getDoubleAttribute("Feedback", 0.5);
+        *mDelayTimeParam = xml->getDoubleAttribute("DelayTime", 0.5);
+        *mInterpolationParam = xml->getIntAttribute("Interpolation", 0);
+        *mLowCutParam = xml->getDoubleAttribute("LowCut", MIN_LOW_CUT);
+        *mHighCutParam = xml->getDoubleAttribute("HighCut", MAX_HIGH_CUT);
+        *mMaxDelayParam = xml->getDoubleAttribute("MaxDelay", DEFAULT_MAX_DELAY_TIME);
+        *mTimeRangeParam = xml->getIntAttribute("TimeRange", 0);
+        *mTapsParam = xml->getIntAttribute("Taps", 1);
+
+        for (int i = 0; i < MAX_TAPS; i++) {
+            Tap& tap = mTaps[i];
+            const String prefix = "Tap" + String(i + 1);
+
+            if (i > 0) {
+                *tap.time = xml->getDoubleAttribute(prefix + "Time", jmin((float) MAX_TIME_PARAMETER, 0.5f + 0.25f * i));
+            }
+
+            *tap.gain = xml->getDoubleAttribute(prefix + "Gain", i == 0 ? 1.0 : 0.5);
+            *tap.pan = xml->getDoubleAttribute(prefix + "Pan", 0.0);
+            *tap.feedback = xml->getDoubleAttribute(prefix + "Feedback", i == 0 ? 1.0 : 0.0);
+            *tap.cross = xml->getDoubleAttribute(prefix + "Cross", 0.0);
+        }
+    }
 }
 
 //==============================================================================
@@ -237,7 +819,3 @@ void BasicDelayAudioProcessor::setStateInformation (const void* data, int sizeIn
 AudioProcessor* JUCE_CALLTYPE createPluginFilter() {
     return new BasicDelayAudioProcessor();
 }
-
-float BasicDelayAudioProcessor::lerp(float sampleX1, float sampleX2, float inPhase) {
-    return (1 - inPhase) * sampleX1 + inPhase * sampleX2;
-}
@@ -15,7 +15,7 @@ BasicGainAudioProcessor::BasicGainAudioProcessor()
 #endif
 {
     addParameter(mGainParam = new AudioParameterFloat("gain", "Gain", 0.0f, 1.0f, 0.5f));
-    mGainSmoothed = 0.5f;
+    mGainSmoothed.setCurrentAndTargetValue(0.5f);
 }
 
 BasicGainAudioProcessor::~BasicGainAudioProcessor() {
@@ -78,8 +78,10 @@ void BasicGainAudioProcessor::changeProgramName (int index, const String& newNam
 
 //==============================================================================
 void BasicGainAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock) {
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
+    mArena.build([this, sampleRate, samplesPerBlock] {
+        // The smoothing time is in milliseconds, so the step size depends on the sample rate
+        mGainSmoothed.prepare(sampleRate, samplesPerBlock);
+    });
 }
 
 void BasicGainAudioProcessor::releaseResources() {
@@ -93,10 +95,8 @@ bool BasicGainAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
     ignoreUnused (layouts);
     return true;
 #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    if (layouts.getMainOutputChannelSet() != AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != AudioChannelSet::stereo())
+    // Every channel gets the same gain, so any layout works as long as there is one
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -111,6 +111,19 @@ bool BasicGainAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
 #endif
 
 void BasicGainAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages) {
+    process(buffer);
+}
+
+void BasicGainAudioProcessor::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midiMessages) {
+    process(buffer);
+}
+
+bool BasicGainAudioProcessor::supportsDoublePrecisionProcessing() const {
+    return true;
+}
+
+template <typename SampleType>
+void BasicGainAudioProcessor::process (AudioBuffer<SampleType>& buffer) {
     ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -125,21 +138,47 @@ void BasicGainAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuff
         buffer.clear (i, 0, buffer.getNumSamples());
     }
 
-    // This is the place where you'd normally do the guts of your plugin's
-    // audio processing...
-    // Make sure to reset the state if your inner loop is processing
-    // the samples and the outer loop is handling the channels.
-    // Alternatively, you can process the samples with the channels
-    // interleaved by keeping the same state.
+    SampleType* const* channels = buffer.getArrayOfWritePointers();
+    const int numChannels = totalNumInputChannels;
+    const int numSamples = buffer.getNumSamples();
+
+    // Read the parameter once per block, not once per sample
+    mGainSmoothed.setTargetValue(mGainParam->get());
+
+    // While the gain glides, every channel is multiplied by the ramp. Hosts can send more samples
+    // than promised in prepareToPlay(), so take the ramp in chunks it can hold.
+    int start = 0;
+
+    for (; start < numSamples && mGainSmoothed.isSmoothing(); start += mGainSmoothed.getMaxBlockSize()) {
+        const int numChunkSamples = jmin(mGainSmoothed.getMaxBlockSize(), numSamples - start);
+        const float* gain = mGainSmoothed.getRamp(numChunkSamples);
+
+        // Plain loops, so they're vectorised for whichever instruction set this CPU has
+        dispatchSIMD([=] {
+            for (int channel = 0; channel < numChannels; channel++) {
+                SampleType* samples = channels[channel] + start;
+
+                for (int i = 0; i < numChunkSamples; i++) {
+                    samples[i] *= gain[i];
+                }
+            }
+        });
+    }
 
-    float* channelLeft = buffer.getWritePointer(0);
-    float* channelRight = buffer.getWritePointer(1);
+    // Once it has settled, which is nearly all the time, the rest of the buffer only needs one
+    // constant multiply. At unity gain that leaves the samples as they are, so it's skipped.
+    const float gain = mGainSmoothed.getCurrentValue();
 
-    for (int sample = 0; sample < buffer.getNumSamples(); sample++) {
-        mGainSmoothed = mGainSmoothed - 0.004 * (mGainSmoothed - mGainParam->get());
+    if (start < numSamples && gain != 1.0f) {
+        dispatchSIMD([=] {
+            for (int channel = 0; channel < numChannels; channel++) {
+                SampleType* samples = channels[channel];
 
-        channelLeft[sample] *= mGainSmoothed;
-        channelRight[sample] *= mGainSmoothed;
+                for (int i = start; i < numSamples; i++) {
+                    samples[i] *= gain;
+                }
+            }
+        });
     }
 }
 
@@ -1,6 +1,9 @@
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include "JuceHeader.h"
+#include "../../Common/Arena.h"
+#include "../../Common/SmoothedParameter.h"
+#include "../../Common/SIMD.h"
 
 //==============================================================================
 /**
@@ -22,6 +25,8 @@ public:
 #endif
 
     void processBlock (AudioBuffer<float>&, MidiBuffer&) override;
+    void processBlock (AudioBuffer<double>&, MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     AudioProcessorEditor* createEditor() override;
@@ -48,8 +53,17 @@ public:
 
 private:
 
+    /** Both processBlock()s share this, so a 64-bit host's blocks are processed as they are rather than converted. */
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& buffer);
+
     AudioParameterFloat* mGainParam;
-    float mGainSmoothed;
+
+    // Holds the ramp, so it's declared first and goes last
+    Arena mArena;
+
+    // Glides over 40ms, which is about what the old per-sample smoothing took at 44.1kHz
+    SmoothedParameter<float> mGainSmoothed { 40.0, SmoothedParameter<float>::Ramp::exponential };
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BasicGainAudioProcessor)
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "MemoryPool.h"
+
+//==============================================================================
+/**
+    One block of memory for everything a processor sizes in prepareToPlay(): its
+    delay lines, filters, ramps and scratch buffers.
+
+    Containers built while a ScopedArena is in place take their memory from the
+    arena, one after the other, each starting on a 64-byte boundary. That's a
+    cache line, and the widest vector register. One instance's state then sits
+    together in as few pages as it can, rather than wherever the heap had room,
+    which counts once hundreds of instances take turns on the same core.
+
+    The arena only finds out how big it has to be by being asked, so build()
+    prepares in passes. Each pass starts a block as big as the last one asked
+    for, so it's two passes the first time and one after that, unless something
+    grows. Anything that doesn't fit goes on the heap, still aligned, and so does
+    anything built outside a ScopedArena.
+
+    Blocks come from the MemoryPool, and everything the arena hands out is
+    zeroed. Freeing only counts down. A block goes back to the pool once
+    everything in it has been freed and a newer block has taken over, so a pass
+    can build the new state before the old state is gone. With
+    setUseHugePages(), the pool backs big blocks with transparent huge pages.
+ */
+class Arena {
+
+public:
+
+    static constexpr size_t alignment = MemoryPool::alignment;
+
+    Arena() = default;
+
+    ~Arena() {
+        for (auto& block : mBlocks) {
+            freeBlock(block);
+        }
+    }
+
+    Arena (const Arena&) = delete;
+    Arena& operator= (const Arena&) = delete;
+
+    //==============================================================================
+    /** Calls prepare(), which allocates everything with a ScopedArena in place, until it all fits
+        in one block. It must build everything from scratch each time, and since it can run twice,
+        anything that shouldn't happen twice, like telling the host about latency or starting a
+        thread, belongs after build() instead. Not real-time safe.
+     */
+    template <typename Function>
+    void build (Function&& prepare) {
+        do {
+            ScopedArena scopedArena(*this);
+            prepare();
+        } while (mNumBytesUsed < mNumBytesRequested);
+    }
+
+    /** The size of the block in use, and how much of it the last pass took. */
+    size_t getCapacity() const noexcept                 { return mBlocks.empty() ? 0 : mBlocks.back().memory.size; }
+    size_t getNumBytesUsed() const noexcept             { return mNumBytesUsed; }
+
+    bool isUsingHugePages() const noexcept              { return ! mBlocks.empty() && mBlocks.back().memory.isMapped; }
+
+    /** Whether blocks made from now on, by any arena, ask the pool for transparent huge pages. */
+    static void setUseHugePages (bool shouldUseHugePages) noexcept      { getUseHugePages() = shouldUseHugePages; }
+
+    //==============================================================================
+    /** The next numBytes of the block, zeroed, or heap memory if they don't fit. Not real-time safe. */
+    void* allocate (size_t numBytes) {
+        // Rounded up so the next one is aligned too, and never empty, so every pointer is inside its block
+        numBytes = (std::max(numBytes, (size_t) 1) + alignment - 1) & ~(alignment - 1);
+        mNumBytesRequested += numBytes;
+
+        if (! mBlocks.empty() && mNumBytesUsed + numBytes <= mBlocks.back().memory.size) {
+            Block& block = mBlocks.back();
+            void* memory = block.getData() + mNumBytesUsed;
+            mNumBytesUsed += numBytes;
+            block.numBytesDirty = std::max(block.numBytesDirty, mNumBytesUsed);
+            block.numLive++;
+            return memory;
+        }
+
+        return allocateAligned(numBytes);
+    }
+
+    void deallocate (void* memory) noexcept {
+        for (size_t i = 0; i < mBlocks.size(); i++) {
+            Block& block = mBlocks[i];
+
+            if (memory >= block.getData() && memory < block.getData() + block.memory.size) {
+                if (--block.numLive == 0 && i + 1 < mBlocks.size()) {
+                    freeBlock(block);
+                    mBlocks.erase(mBlocks.begin() + (std::ptrdiff_t) i);
+                }
+
+                return;
+            }
+        }
+
+        freeAligned(memory);
+    }
+
+    //==============================================================================
+    /** Zeroed heap memory on an alignment boundary, for when there's no arena. */
+    static void* allocateAligned (size_t numBytes) {
+        void* memory = std::calloc(numBytes + alignment, 1);
+
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        // malloc() is at least 8-byte aligned, so there's always room before the boundary to say where it started
+        const uintptr_t aligned = (reinterpret_cast<uintptr_t>(memory) + alignment) & ~(uintptr_t) (alignment - 1);
+        reinterpret_cast<void**>(aligned)[-1] = memory;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    static void freeAligned (void* memory) noexcept {
+        if (memory != nullptr) {
+            std::free(static_cast<void**>(memory)[-1]);
+        }
+    }
+
+    //==============================================================================
+    /** Makes an arena the one containers built on this thread take their memory from, and starts
+        a pass on it, until it goes out of scope.
+     */
+    class ScopedArena {
+
+    public:
+
+        explicit ScopedArena (Arena& arena) : mPrevious (getCurrent()) {
+            arena.begin();
+            getCurrent() = &arena;
+        }
+
+        ~ScopedArena() {
+            getCurrent() = mPrevious;
+        }
+
+        ScopedArena (const ScopedArena&) = delete;
+        ScopedArena& operator= (const ScopedArena&) = delete;
+
+    private:
+
+        Arena* mPrevious;
+
+    };
+
+    /** The arena of the innermost ScopedArena on this thread, or nullptr. */
+    static Arena*& getCurrent() noexcept {
+        static thread_local Arena* current = nullptr;
+        return current;
+    }
+
+private:
+
+    struct Block {
+        MemoryPool::Block memory;
+        size_t numLive;
+        size_t numBytesDirty;
+
+        char* getData() const noexcept                  { return static_cast<char*>(memory.data); }
+    };
+
+    static std::atomic<bool>& getUseHugePages() noexcept {
+        static std::atomic<bool> useHugePages { false };
+        return useHugePages;
+    }
+
+    /** Starts a pass, in a block as big as the last pass asked for. The block in use is only
+        reused if nothing in it is still allocated and it's big enough, and then it's cleared.
+     */
+    void begin() {
+        const size_t size = std::max(mNumBytesRequested, mNumBytesUsed);
+        const bool canReuse = ! mBlocks.empty() && mBlocks.back().numLive == 0 && mBlocks.back().memory.size >= size;
+
+        if (canReuse) {
+            Block& block = mBlocks.back();
+            std::memset(block.getData(), 0, block.numBytesDirty);
+            block.numBytesDirty = 0;
+        } else if (size > 0) {
+            if (! mBlocks.empty() && mBlocks.back().numLive == 0) {
+                freeBlock(mBlocks.back());
+                mBlocks.pop_back();
+            }
+
+            mBlocks.push_back({ MemoryPool::getInstance().allocate(size, getUseHugePages()), 0, 0 });
+        }
+
+        mNumBytesUsed = 0;
+        mNumBytesRequested = 0;
+    }
+
+    static void freeBlock (Block& block) noexcept {
+        MemoryPool::getInstance().release(block.memory);
+    }
+
+    // Keeps the pool's blocks for the next instance while this one's around
+    MemoryPool::User mPoolUser;
+
+    // The newest block is the one being allocated from. Older ones wait for what's left in them to be freed.
+    std::vector<Block> mBlocks;
+    size_t mNumBytesUsed = 0;
+    size_t mNumBytesRequested = 0;
+
+};
+
+//==============================================================================
+/** An allocator for std containers that takes memory from whichever arena was current when
+    it was made, or from the heap, 64-byte aligned and zeroed either way. A container copied
+    inside a ScopedArena moves into that arena.
+ */
+template <typename Type>
+class ArenaAllocator {
+
+public:
+
+    using value_type = Type;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() noexcept : mArena (Arena::getCurrent()) {}
+
+    template <typename Other>
+    ArenaAllocator (const ArenaAllocator<Other>& other) noexcept : mArena (other.getArena()) {}
+
+    Type* allocate (size_t numElements) {
+        const size_t numBytes = numElements * sizeof(Type);
+        return static_cast<Type*>(mArena != nullptr ? mArena->allocate(numBytes) : Arena::allocateAligned(numBytes));
+    }
+
+    void deallocate (Type* memory, size_t) noexcept {
+        if (mArena != nullptr) {
+            mArena->deallocate(memory);
+        } else {
+            Arena::freeAligned(memory);
+        }
+    }
+
+    /** The memory is zeroed already, so elements built with no arguments are default-initialised
+        rather than value-initialised, and a trivial Type isn't cleared a second time.
+     */
+    template <typename Element>
+    void construct (Element* element) {
+        ::new (static_cast<void*>(element)) Element;
+    }
+
+    template <typename Element, typename... Args>
+    void construct (Element* element, Args&&... args) {
+        ::new (static_cast<void*>(element)) Element(std::forward<Args>(args)...);
+    }
+
+    ArenaAllocator select_on_container_copy_construction() const noexcept    { return ArenaAllocator(); }
+
+    Arena* getArena() const noexcept                    { return mArena; }
+
+    template <typename Other>
+    bool operator== (const ArenaAllocator<Other>& other) const noexcept      { return mArena == other.getArena(); }
+
+    template <typename Other>
+    bool operator!= (const ArenaAllocator<Other>& other) const noexcept      { return mArena != other.getArena(); }
+
+private:
+
+    Arena* mArena;
+
+};
+
+/** A std::vector that lives in the current arena. Build a new one in prepare() rather than
+    resizing the old one, so it moves into the arena being built. Built with just a size, its
+    elements start out zeroed. Shrinking one and growing it again doesn't clear what grew back.
+ */
+template <typename Type>
+using ArenaVector = std::vector<Type, ArenaAllocator<Type>>;
+
+//==============================================================================
+/**
+    A few channels of scratch samples in the arena, with the accessors of a JUCE
+    AudioBuffer. Every channel starts on a 64-byte boundary.
+ */
+template <typename SampleType>
+class ArenaBuffer {
+
+public:
+
+    /** Makes room for numSamples of numChannels, cleared. Not real-time safe. */
+    void setSize (int numChannels, int numSamples) {
+        constexpr int samplesPerLine = (int) (Arena::alignment / sizeof(SampleType));
+
+        mNumChannels = numChannels;
+        mNumSamples = numSamples;
+        mStride = (numSamples + samplesPerLine - 1) / samplesPerLine * samplesPerLine;
+        mData = ArenaVector<SampleType>((size_t) (numChannels * mStride));
+    }
+
+    int getNumChannels() const noexcept                 { return mNumChannels; }
+    int getNumSamples() const noexcept                  { return mNumSamples; }
+
+    SampleType* getWritePointer (int channel) noexcept                  { return mData.data() + channel * mStride; }
+    const SampleType* getReadPointer (int channel) const noexcept       { return mData.data() + channel * mStride; }
+
+private:
+
+    ArenaVector<SampleType> mData;
+    int mNumChannels = 0;
+    int mNumSamples = 0;
+    int mStride = 0;
+
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+//==============================================================================
+/**
+    NumStages second-order filters in series, in transposed direct form II, for
+    NumChannels channels that share each stage's coefficients.
+
+    A biquad feeds every output into the next, so one channel can't be split
+    across vector lanes. The channels can, though: each sample runs the same
+    few multiply-adds on all NumChannels of them at once, over arrays that the
+    compiler turns into single vector operations. process() interleaves the
+    channels a tile at a time to get them side by side, and splits them back
+    out afterwards. Each sample waits on the one before, so one stage is bound
+    by that chain rather than by arithmetic, and running the stages in the same
+    pass lets their chains overlap for about the cost of one.
+
+    The coefficients are the usual RBJ cookbook ones, at a Butterworth Q.
+ */
+template <typename SampleType, int NumChannels, int NumStages = 1>
+class Biquad {
+
+public:
+
+    /** Normalised so a0 is 1. The defaults pass the signal straight through, exactly,
+        and flush the stage's state within two samples.
+     */
+    struct Coefficients {
+        SampleType b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    };
+
+    /** A highpass, for cutting everything below frequency. */
+    static Coefficients makeLowCut (double sampleRate, double frequency) noexcept {
+        const double cosW = std::cos(getAngularFrequency(sampleRate, frequency));
+        return normalise((1 + cosW) / 2, -(1 + cosW), (1 + cosW) / 2, sampleRate, frequency);
+    }
+
+    /** A lowpass, for cutting everything above frequency. */
+    static Coefficients makeHighCut (double sampleRate, double frequency) noexcept {
+        const double cosW = std::cos(getAngularFrequency(sampleRate, frequency));
+        return normalise((1 - cosW) / 2, 1 - cosW, (1 - cosW) / 2, sampleRate, frequency);
+    }
+
+    //==============================================================================
+    /** Takes effect from the next sample, keeping the state. Real-time safe. */
+    void setCoefficients (int stage, const Coefficients& coefficients) noexcept {
+        mCoefficients[stage] = coefficients;
+    }
+
+    void reset() noexcept {
+        std::fill(&mState1[0][0], &mState1[0][0] + NumStages * NumChannels, SampleType());
+        std::fill(&mState2[0][0], &mState2[0][0] + NumStages * NumChannels, SampleType());
+    }
+
+    /** Filters numSamples of every channel from source into dest, which can be the same arrays. */
+    void process (const SampleType* const* source, SampleType* const* dest, int numSamples) noexcept {
+        // Local copies, so the compiler can keep them in registers across the loop
+        Coefficients c[NumStages];
+        SampleType s1[NumStages][NumChannels], s2[NumStages][NumChannels];
+
+        std::copy(mCoefficients, mCoefficients + NumStages, c);
+        std::copy(&mState1[0][0], &mState1[0][0] + NumStages * NumChannels, &s1[0][0]);
+        std::copy(&mState2[0][0], &mState2[0][0] + NumStages * NumChannels, &s2[0][0]);
+
+        constexpr int numTileFrames = 64;
+        SampleType tile[numTileFrames * NumChannels];
+
+        for (int start = 0; start < numSamples; start += numTileFrames) {
+            const int numFrames = std::min(numTileFrames, numSamples - start);
+
+            for (int channel = 0; channel < NumChannels; channel++) {
+                const SampleType* in = source[channel] + start;
+
+                for (int i = 0; i < numFrames; i++) {
+                    tile[i * NumChannels + channel] = in[i];
+                }
+            }
+
+            for (int i = 0; i < numFrames; i++) {
+                SampleType* frame = tile + i * NumChannels;
+
+                for (int stage = 0; stage < NumStages; stage++) {
+                    const Coefficients& k = c[stage];
+                    SampleType* state1 = s1[stage];
+                    SampleType* state2 = s2[stage];
+
+                    // GCC unrolls a loop this short before it gets to vectorise it, and then leaves it scalar
+#if defined (__GNUC__) && ! defined (__clang__)
+                    #pragma GCC unroll 1
+#endif
+                    for (int channel = 0; channel < NumChannels; channel++) {
+                        const SampleType x = frame[channel];
+                        const SampleType y = k.b0 * x + state1[channel];
+
+                        // Only the last two operations wait on y, which keeps the chain from one sample to the next short
+                        state1[channel] = (k.b1 * x + state2[channel]) - k.a1 * y;
+                        state2[channel] = k.b2 * x - k.a2 * y;
+                        frame[channel] = y;
+                    }
+                }
+            }
+
+            for (int channel = 0; channel < NumChannels; channel++) {
+                SampleType* out = dest[channel] + start;
+
+                for (int i = 0; i < numFrames; i++) {
+                    out[i] = tile[i * NumChannels + channel];
+                }
+            }
+        }
+
+        std::copy(&s1[0][0], &s1[0][0] + NumStages * NumChannels, &mState1[0][0]);
+        std::copy(&s2[0][0], &s2[0][0] + NumStages * NumChannels, &mState2[0][0]);
+    }
+
+private:
+
+    /** Kept just short of Nyquist, where the cookbook formulas fall apart. */
+    static double getAngularFrequency (double sampleRate, double frequency) noexcept {
+        return 2 * 3.141592653589793 * std::min(frequency, 0.49 * sampleRate) / sampleRate;
+    }
+
+    static Coefficients normalise (double b0, double b1, double b2, double sampleRate, double frequency) noexcept {
+        const double w = getAngularFrequency(sampleRate, frequency);
+        const double alpha = std::sin(w) / (2 * 0.7071067811865476);
+        const double a0 = 1 + alpha;
+
+        Coefficients c;
+        c.b0 = (SampleType) (b0 / a0);
+        c.b1 = (SampleType) (b1 / a0);
+        c.b2 = (SampleType) (b2 / a0);
+        c.a1 = (SampleType) (-2 * std::cos(w) / a0);
+        c.a2 = (SampleType) ((1 - alpha) / a0);
+        return c;
+    }
+
+    Coefficients mCoefficients[NumStages];
+
+    SampleType mState1[NumStages][NumChannels] = {};
+    SampleType mState2[NumStages][NumChannels] = {};
+
+};
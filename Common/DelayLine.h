@@ -0,0 +1,728 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Arena.h"
+#include "Interpolation.h"
+#include "PagedBuffer.h"
+
+//==============================================================================
+/**
+    A circular buffer of past samples for one channel.
+
+    The capacity is rounded up to a power of two, so wrapping an index is a single
+    bitwise AND with a mask instead of a compare and subtract. That takes the
+    unpredictable wrap-around branches out of the per-sample loop.
+
+    pushSample() stores the newest sample, which read(0) then returns. Delays
+    are measured back from there, in samples.
+
+    The first few samples of the buffer are mirrored into a guard zone past its
+    end, so a run of taps starting anywhere in the buffer can be read without
+    wrapping. Interpolators get at that run through getReadPointer().
+
+    Fractional reads use whichever Interpolation was set last. The guard zone is
+    always wide enough for the longest kernel, so it can be switched at any time.
+
+    With Storage::paged the history lives in a PagedBuffer instead, so a line with
+    room for minutes only takes memory for the pages that have had sound written
+    to them, and preparing it doesn't have to allocate or clear all of it. A page
+    that a whole page of silence has been written over is given back, and so is
+    any page further back than setReach() allows. Each block read first copies
+    just the stretch of history its taps reach into a small window, and then runs
+    the same kernels on that. There's no guard zone, so getReadPointer() doesn't
+    work, and servicePages() has to be called every few milliseconds from another
+    thread to keep the pages coming.
+
+    Storage::int16 pages 16-bit integers instead, which also halves the memory
+    and the cache traffic of every tap. Each block pushed is scaled, dithered and
+    rounded in one vectorised pass, and each window is converted back, also in one
+    pass. Full scale is +12 dBFS, and anything louder clips. The dither is
+    triangular and 2 LSBs wide, which leaves a flat noise floor about 84 dB below
+    0 dBFS every time a sample goes through the line. It's gated, though: samples
+    within half a step of zero, about -84 dBFS, are stored as zero undithered, so
+    a feedback tail dies away rather than circulating dither for ever. The error
+    on those quiet samples is the samples themselves, so it does follow the signal.
+ */
+template <typename SampleType>
+class DelayLine {
+
+public:
+
+    /** How the history is kept: in one buffer, in pages, or in pages dithered down to 16 bits. */
+    enum class Storage {
+        native,
+        paged,
+        int16
+    };
+
+    //==============================================================================
+    /** Makes room for reads up to maxDelayInSamples back, including the extra taps
+        fractional reads need, and clears the history. numGuardSamples is how many
+        taps past the first one getReadPointer() must keep contiguous, and is at
+        least what the longest interpolation kernel needs. For paged storage,
+        maxPushesBetweenServices is the most samples pushed between two calls to
+        servicePages(), which sets how many spare pages are kept. They're only
+        allocated by servicePages(), so call it before the first push. Allocates in
+        the current Arena if there is one, apart from paged storage's pages, which it
+        gives back. Not real-time safe, and servicePages() mustn't run while it does.
+     */
+    void prepare (int maxDelayInSamples, int numGuardSamples = 1, Storage storage = Storage::native,
+                  int maxPushesBetweenServices = 0) {
+        numGuardSamples = std::max(numGuardSamples, SincInterpolator<SampleType, 16>::numTaps - 1);
+
+        // Build the sinc tables now rather than on the audio thread
+        SincInterpolator<SampleType, 8>::getTable();
+        SincInterpolator<SampleType, 16>::getTable();
+
+        int capacity = 1;
+
+        while (capacity < maxDelayInSamples + numGuardSamples + 1) {
+            capacity <<= 1;
+        }
+
+        mPages = PagedBuffer<SampleType>();
+        mCompactPages = PagedBuffer<int16_t>();
+
+        if (storage == Storage::native) {
+            mBuffer = ArenaVector<SampleType>((size_t) (capacity + numGuardSamples));
+        } else {
+            // mBuffer is then only the window block reads copy into
+            capacity = std::max(capacity, (int) PagedBuffer<SampleType>::pageSize);
+            mBuffer = ArenaVector<SampleType>((size_t) windowSize);
+
+            if (storage == Storage::int16) {
+                mCompactPages.prepare(capacity, maxPushesBetweenServices);
+            } else {
+                mPages.prepare(capacity, maxPushesBetweenServices);
+            }
+        }
+
+        mStorage = storage;
+        mMask = capacity - 1;
+        mGuardSize = numGuardSamples;
+        mWriteHead = 0;
+        mAllpassState = 0;
+
+        mReleaseHead = 0;
+        mSilentRun = 0;
+        setReach(maxDelayInSamples);
+    }
+
+    /** Clears the history without reallocating. */
+    void clear() noexcept {
+        std::fill(mBuffer.begin(), mBuffer.end(), SampleType());
+        clearPages(mPages);
+        clearPages(mCompactPages);
+        mAllpassState = 0;
+    }
+
+    Storage getStorage() const noexcept                 { return mStorage; }
+
+    /** The longest delay paged storage keeps pages for, which can be anything up to the
+        capacity. Pages further back than that are given back a few at a time as the write
+        head moves on. Raising it doesn't bring back what's already gone, so the history it
+        opens up reads as silence until it's been written again. Real-time safe.
+     */
+    void setReach (int maxDelayInSamples) noexcept {
+        // The oldest a window ever reaches is its margin past the longest delay
+        mReachInPages = (maxDelayInSamples + mGuardSize + 3) / PagedBuffer<SampleType>::pageSize + 1;
+    }
+
+    /** Allocates spare pages for paged storage and frees the ones it's given back. Call it
+        every few milliseconds from a thread that isn't the audio thread. Not real-time safe.
+     */
+    void servicePages() {
+        mPages.service();
+        mCompactPages.service();
+    }
+
+    /** Starts the int16 dither's noise sequence from seed. Lines that run side by side,
+        like the channels of one signal, should each get their own, so their noise
+        doesn't add up coherently.
+     */
+    void setDitherSeed (uint32_t seed) noexcept         { mDitherCounter = seed * 0x10000u; }
+
+    /** Picks the kernel for fractional reads. Real-time safe. */
+    void setInterpolation (Interpolation interpolation) noexcept {
+        if (interpolation != mInterpolation) {
+            mInterpolation = interpolation;
+            mAllpassState = 0;
+        }
+    }
+
+    Interpolation getInterpolation() const noexcept     { return mInterpolation; }
+
+    /** The Thiran allpass carries its last output over to the next read. Read heads
+        sharing one delay line each keep their own, set before their reads and saved after.
+     */
+    SampleType getAllpassState() const noexcept         { return mAllpassState; }
+    void setAllpassState (SampleType state) noexcept    { mAllpassState = state; }
+
+    /** How many samples newer than the whole part of the delay the current kernel
+        reads. Delays must be at least this long, and the block reads need every
+        delay to be longer than the block plus this.
+     */
+    int getLookahead() const noexcept {
+        return getInterpolationLookahead(mInterpolation);
+    }
+
+    int getCapacity() const noexcept                    { return mMask + 1; }
+
+    int getGuardSize() const noexcept                   { return mGuardSize; }
+
+    /** The longest delay that read() and readFractional() can reach. */
+    int getMaxDelay() const noexcept                    { return mMask - mGuardSize; }
+
+    //==============================================================================
+    /** Advances the write head and stores the newest sample there, and in the guard zone if it's mirrored. */
+    void pushSample (SampleType sample) noexcept {
+        if (mStorage != Storage::native) {
+            pushBlock(&sample, 1);
+            return;
+        }
+
+        mWriteHead = (mWriteHead + 1) & mMask;
+        mBuffer[(size_t) mWriteHead] = sample;
+
+        if (mWriteHead < mGuardSize) {
+            mBuffer[(size_t) (mWriteHead + mMask + 1)] = sample;
+        }
+    }
+
+    /** Pushes a whole block, as if pushSample() were called on each sample in turn.
+        numSamples must be no more than the capacity.
+     */
+    void pushBlock (const SampleType* samples, int numSamples) noexcept {
+        const int start = (mWriteHead + 1) & mMask;
+        const int numBeforeEnd = std::min(numSamples, mMask + 1 - start);
+
+        if (mStorage == Storage::int16) {
+            pushPaged(mCompactPages, samples, numSamples);
+            return;
+        }
+
+        if (mStorage == Storage::paged) {
+            pushPaged(mPages, samples, numSamples);
+            return;
+        }
+
+        std::copy(samples, samples + numBeforeEnd, mBuffer.data() + start);
+        std::copy(samples + numBeforeEnd, samples + numSamples, mBuffer.data());
+
+        // Refresh the mirrored copy if the block touched the start of the buffer
+        if (start < mGuardSize || numBeforeEnd < numSamples) {
+            std::copy(mBuffer.data(), mBuffer.data() + mGuardSize, mBuffer.data() + mMask + 1);
+        }
+
+        mWriteHead = (mWriteHead + numSamples) & mMask;
+    }
+
+    /** Moves the write head on by numSamples of silence, as if pushBlock() were given that
+        many zeros, but without needing them. Any number of samples will do, and more than the
+        capacity leaves nothing but silence. Paged storage gives back the pages it clears the
+        way pushBlock() would. Real-time safe.
+     */
+    void advance (int numSamples) noexcept {
+        mAllpassState = 0;
+
+        if (mStorage == Storage::int16) {
+            advancePaged(mCompactPages, numSamples);
+            return;
+        }
+
+        if (mStorage == Storage::paged) {
+            advancePaged(mPages, numSamples);
+            return;
+        }
+
+        const int start = (mWriteHead + 1) & mMask;
+        const int numToClear = std::min(numSamples, mMask + 1);
+        const int numBeforeEnd = std::min(numToClear, mMask + 1 - start);
+
+        std::fill(mBuffer.data() + start, mBuffer.data() + start + numBeforeEnd, SampleType());
+        std::fill(mBuffer.data(), mBuffer.data() + numToClear - numBeforeEnd, SampleType());
+
+        if (start < mGuardSize || numBeforeEnd < numToClear) {
+            std::copy(mBuffer.data(), mBuffer.data() + mGuardSize, mBuffer.data() + mMask + 1);
+        }
+
+        mWriteHead = (mWriteHead + numSamples) & mMask;
+    }
+
+    /** Returns the sample pushed delayInSamples samples ago. */
+    SampleType read (int delayInSamples) const noexcept {
+        const int index = (mWriteHead - delayInSamples) & mMask;
+
+        if (mStorage != Storage::native) {
+            SampleType sample;
+            copyToWindow(index, &sample, 1);
+            return sample;
+        }
+
+        return mBuffer[(size_t) index];
+    }
+
+    /** Returns a pointer to the sample pushed delayInSamples ago. The getGuardSize()
+        samples after it are the ones pushed after it, in order, with no wrapping.
+        Only for Storage::native.
+     */
+    const SampleType* getReadPointer (int delayInSamples) const noexcept {
+        return mBuffer.data() + ((mWriteHead - delayInSamples) & mMask);
+    }
+
+    /** Returns the signal delayInSamples ago, interpolated between the samples around it. */
+    SampleType readFractional (SampleType delayInSamples) noexcept {
+        if (mStorage != Storage::native) {
+            SampleType sample;
+            readWindowedBlock(mWriteHead, delayInSamples, &sample, 1);
+            return sample;
+        }
+
+        // Linear is small enough to inline into per-sample loops, so it skips the switch
+        if (mInterpolation == Interpolation::linear) {
+            return interpolate<LinearInterpolator<SampleType>>(mBuffer.data(), mMask, mWriteHead, delayInSamples);
+        }
+
+        return readFractionalWithKernel(delayInSamples);
+    }
+
+    /** Reads a block the way pushBlock() followed by per-sample readFractional() calls
+        would, with sample i read as if the first i + 1 samples of the block had been
+        pushed. That only works when every delay is longer than numSamples plus
+        getLookahead(), so none of the taps has to wait for the block it's read in.
+        Call it before pushBlock().
+     */
+    void readFractionalBlock (const SampleType* delayInSamples, SampleType* dest, int numSamples) noexcept {
+        if (mStorage != Storage::native) {
+            readWindowedBlock(mWriteHead + 1, delayInSamples, dest, numSamples);
+        } else {
+            readBlockFrom(mBuffer.data(), mMask, mWriteHead + 1, delayInSamples, dest, numSamples);
+        }
+    }
+
+    /** The same as readFractionalBlock(), for a delay that stays put for the whole block.
+        Every output then uses the same weights on the same run of neighbours, so the
+        block is one short convolution over a contiguous run, or two when it wraps.
+     */
+    void readFractionalBlock (SampleType delayInSamples, SampleType* dest, int numSamples) noexcept {
+        if (mStorage != Storage::native) {
+            readWindowedBlock(mWriteHead + 1, delayInSamples, dest, numSamples);
+        } else {
+            readBlockFrom(mBuffer.data(), mMask, mWriteHead + 1, delayInSamples, dest, numSamples);
+        }
+    }
+
+private:
+
+    /** The paged window's length. Block reads whose taps spread wider than this, because the
+        delay sweeps a long way within the block, are read in shorter pieces.
+     */
+    static constexpr int windowSize = 2048;
+
+    /** What one int16 step is worth, with full scale at 4, or +12 dBFS. */
+    static SampleType getLSB() noexcept                 { return (SampleType) (4.0 / 32768.0); }
+
+    //==============================================================================
+    /** The block reads, from any buffer laid out like mBuffer. firstWriteHead is the write
+        head for the first output, which moves on by one for each output after it.
+     */
+    void readBlockFrom (const SampleType* buffer, int mask, int firstWriteHead,
+                        const SampleType* delayInSamples, SampleType* dest, int numSamples) noexcept {
+        switch (mInterpolation) {
+            case Interpolation::hermite:    readBlockFourAtATime<HermiteInterpolator<SampleType>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+            case Interpolation::lagrange:   readBlockFourAtATime<LagrangeInterpolator<SampleType>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+            case Interpolation::sinc8:      readBlock<SincInterpolator<SampleType, 8>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+            case Interpolation::sinc16:     readBlock<SincInterpolator<SampleType, 16>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+            case Interpolation::linear:     readBlockFourAtATime<LinearInterpolator<SampleType>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+
+            // The allpass feeds each output into the next, so it can only go one sample at a time
+            case Interpolation::thiran:
+                for (int i = 0; i < numSamples; i++) {
+                    dest[i] = interpolateAllpass(buffer, mask, firstWriteHead + i, delayInSamples[i]);
+                }
+                break;
+        }
+    }
+
+    void readBlockFrom (const SampleType* buffer, int mask, int firstWriteHead,
+                        SampleType delayInSamples, SampleType* dest, int numSamples) noexcept {
+        switch (mInterpolation) {
+            case Interpolation::hermite:    convolveBlock<HermiteInterpolator<SampleType>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+            case Interpolation::lagrange:   convolveBlock<LagrangeInterpolator<SampleType>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+            case Interpolation::sinc8:      convolveBlock<SincInterpolator<SampleType, 8>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+            case Interpolation::sinc16:     convolveBlock<SincInterpolator<SampleType, 16>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+            case Interpolation::linear:     convolveBlock<LinearInterpolator<SampleType>>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples); break;
+
+            case Interpolation::thiran:
+                for (int i = 0; i < numSamples; i++) {
+                    dest[i] = interpolateAllpass(buffer, mask, firstWriteHead + i, delayInSamples);
+                }
+                break;
+        }
+    }
+
+    /** Block reads from paged storage. Each piece of the block copies the stretch of history
+        its taps can reach into mBuffer, then reads that with the usual kernels. The window
+        starts at ring position windowStart, so a write head there becomes one windowStart back
+        in the window, and it never wraps.
+     */
+    template <typename Delay>
+    void readWindowedBlock (int firstWriteHead, Delay delayInSamples, SampleType* dest, int numSamples) noexcept {
+        // Room for every kernel's taps either side of the delay, and Thiran's shift by one
+        const int margin = mGuardSize + 2;
+
+        for (int start = 0; start < numSamples;) {
+            int numToRead = std::min(numSamples - start, windowSize / 2);
+            int shortestDelay, longestDelay;
+
+            for (;;) {
+                getDelayRange(delayInSamples, start, numToRead, shortestDelay, longestDelay);
+
+                if (numToRead + longestDelay - shortestDelay + 2 * margin <= windowSize || numToRead == 1) {
+                    break;
+                }
+
+                numToRead /= 2;
+            }
+
+            const int writeHead = firstWriteHead + start;
+            const int windowStart = writeHead - longestDelay - margin;
+            const int windowLength = numToRead + longestDelay - shortestDelay + 2 * margin;
+
+            copyToWindow(windowStart, mBuffer.data(), windowLength);
+            readBlockFrom(mBuffer.data(), windowSize - 1, writeHead - windowStart,
+                          offsetDelay(delayInSamples, start), dest + start, numToRead);
+
+            start += numToRead;
+        }
+    }
+
+    /** The whole parts of the shortest and longest delays, rounded down and up. Compared as
+        integers, since the compiler can't vectorise a floating point min or max that has to
+        keep NaNs in order.
+     */
+    static void getDelayRange (const SampleType* delayInSamples, int start, int numSamples, int& shortest, int& longest) noexcept {
+        int lowest = (int) delayInSamples[start], highest = lowest;
+
+        for (int i = start + 1; i < start + numSamples; i++) {
+            const int wholeDelay = (int) delayInSamples[i];
+            lowest = std::min(lowest, wholeDelay);
+            highest = std::max(highest, wholeDelay);
+        }
+
+        shortest = lowest;
+        longest = highest + 1;
+    }
+
+    static void getDelayRange (SampleType delayInSamples, int, int, int& shortest, int& longest) noexcept {
+        shortest = (int) delayInSamples;
+        longest = shortest + 1;
+    }
+
+    static const SampleType* offsetDelay (const SampleType* delayInSamples, int start) noexcept  { return delayInSamples + start; }
+    static SampleType offsetDelay (SampleType delayInSamples, int) noexcept                       { return delayInSamples; }
+
+    //==============================================================================
+    /** Stores numSamples as int16, rounded to the nearest step after adding triangular dither.
+        The dither comes from hashing a running counter rather than from a generator that
+        feeds on its last output, so the whole loop vectorises. Samples that would round to
+        zero anyway are stored as zero without it, so silence stays silent, and a feedback
+        loop's tail dies away instead of circulating its own dither for ever.
+     */
+    void encode (const SampleType* source, int16_t* dest, int numSamples) noexcept {
+        const SampleType scale = 1 / getLSB();
+        const uint32_t counter = mDitherCounter;
+
+        for (int i = 0; i < numSamples; i++) {
+            uint32_t hash = (counter + (uint32_t) i) * 0x9e3779b1u;
+            hash ^= hash >> 16;
+            hash *= 0x85ebca6bu;
+            hash ^= hash >> 13;
+
+            // The difference of two uniform 16-bit numbers is triangular, between -1 and 1 steps
+            const SampleType dither = (SampleType) ((int) (hash & 0xffff) - (int) (hash >> 16)) * (SampleType) (1.0 / 65536.0);
+            const SampleType scaled = source[i] * scale;
+            const SampleType x = std::min(std::max(scaled + dither, (SampleType) -32768), (SampleType) 32767);
+
+            // Shifted above zero so truncating rounds to the nearest step
+            const int rounded = (int) (x + (SampleType) 32768.5) - 32768;
+            dest[i] = (int16_t) (std::abs(scaled) <= (SampleType) 0.5 ? 0 : rounded);
+        }
+
+        mDitherCounter = counter + (uint32_t) numSamples;
+    }
+
+    static void store (const SampleType* source, SampleType* dest, int numSamples) noexcept {
+        std::copy(source, source + numSamples, dest);
+    }
+
+    void store (const SampleType* source, int16_t* dest, int numSamples) noexcept {
+        encode(source, dest, numSamples);
+    }
+
+    /** Whether every sample would be stored as zero. NaN wouldn't be, so it isn't silent. */
+    bool isSilent (const SampleType* samples, int numSamples) const noexcept {
+        const SampleType scale = mStorage == Storage::int16 ? 1 / getLSB() : 1;
+        const SampleType limit = mStorage == Storage::int16 ? (SampleType) 0.5 : 0;
+        int numAudible = 0;
+
+        for (int i = 0; i < numSamples; i++) {
+            numAudible += std::abs(samples[i] * scale) <= limit ? 0 : 1;
+        }
+
+        return numAudible == 0;
+    }
+
+    /** Pushes into pages, a page at a time. Silence written where nothing has been yet leaves
+        the page unallocated, and a page that's just been filled with nothing but silence is
+        given back. Then whatever has fallen out of reach is given back.
+     */
+    template <typename ElementType>
+    void pushPaged (PagedBuffer<ElementType>& pages, const SampleType* samples, int numSamples) noexcept {
+        const int pageSize = PagedBuffer<ElementType>::pageSize;
+        int position = (mWriteHead + 1) & mMask;
+
+        for (int i = 0; i < numSamples;) {
+            const int page = position >> PagedBuffer<ElementType>::pageBits;
+            const int offset = position & (pageSize - 1);
+            const int numToWrite = std::min(numSamples - i, pageSize - offset);
+            const bool silent = isSilent(samples + i, numToWrite);
+
+            mSilentRun = silent ? mSilentRun + numToWrite : 0;
+
+            ElementType* dest = ! silent || pages.isAllocated(page) ? pages.getPageForWriting(page) : nullptr;
+
+            if (dest != nullptr) {
+                store(samples + i, dest + offset, numToWrite);
+            } else {
+                // Keeps the int16 dither's sequence where it would have been
+                mDitherCounter += (uint32_t) numToWrite;
+            }
+
+            if (offset + numToWrite == pageSize && mSilentRun >= pageSize) {
+                pages.release(page);
+            }
+
+            position = (position + numToWrite) & mMask;
+            i += numToWrite;
+        }
+
+        mWriteHead = (mWriteHead + numSamples) & mMask;
+        releaseOutOfReach(pages);
+    }
+
+    /** advance() for pages. Pages the silence covers from end to end are given back, and the rest
+        of what it covers is cleared, in pages that have been written.
+     */
+    template <typename ElementType>
+    void advancePaged (PagedBuffer<ElementType>& pages, int numSamples) noexcept {
+        const int pageSize = PagedBuffer<ElementType>::pageSize;
+        const int numToClear = std::min(numSamples, mMask + 1);
+        int position = (mWriteHead + 1) & mMask;
+
+        for (int i = 0; i < numToClear;) {
+            const int page = position >> PagedBuffer<ElementType>::pageBits;
+            const int offset = position & (pageSize - 1);
+            const int numToWrite = std::min(numToClear - i, pageSize - offset);
+
+            // Only compared against a page, so it stops there rather than counting for ever
+            mSilentRun = std::min(mSilentRun + numToWrite, pageSize);
+
+            const bool wholePageSilent = offset + numToWrite == pageSize && mSilentRun >= pageSize;
+
+            if (pages.isAllocated(page) && ! (wholePageSilent && pages.release(page))) {
+                ElementType* dest = pages.getPageForWriting(page);
+                std::fill(dest + offset, dest + offset + numToWrite, ElementType());
+            }
+
+            position = (position + numToWrite) & mMask;
+            i += numToWrite;
+        }
+
+        mDitherCounter += (uint32_t) numSamples;
+        mWriteHead = (mWriteHead + numSamples) & mMask;
+        releaseOutOfReach(pages);
+    }
+
+    /** Gives back whatever has fallen out of reach, a few pages at a time, so shortening the reach
+        a long way doesn't all land on one block.
+     */
+    template <typename ElementType>
+    void releaseOutOfReach (PagedBuffer<ElementType>& pages) noexcept {
+        const int pageMask = pages.getNumPages() - 1;
+        const int writePage = mWriteHead >> PagedBuffer<ElementType>::pageBits;
+
+        for (int i = 0; i < 4 && ((writePage - mReleaseHead) & pageMask) > mReachInPages; i++) {
+            if (! pages.release(mReleaseHead)) {
+                break;
+            }
+
+            mReleaseHead = (mReleaseHead + 1) & pageMask;
+        }
+    }
+
+    /** Copies numSamples of paged history, from ring position first on, into dest, converting
+        int16 back to samples on the way.
+     */
+    void copyToWindow (int first, SampleType* dest, int numSamples) const noexcept {
+        const int pageSize = PagedBuffer<SampleType>::pageSize;
+        const SampleType lsb = getLSB();
+        int position = first & mMask;
+
+        for (int i = 0; i < numSamples;) {
+            const int page = position >> PagedBuffer<SampleType>::pageBits;
+            const int offset = position & (pageSize - 1);
+            const int numToCopy = std::min(numSamples - i, pageSize - offset);
+
+            if (mStorage == Storage::int16) {
+                const int16_t* source = mCompactPages.getPage(page) + offset;
+
+                for (int j = 0; j < numToCopy; j++) {
+                    dest[i + j] = (SampleType) source[j] * lsb;
+                }
+            } else {
+                const SampleType* source = mPages.getPage(page) + offset;
+                std::copy(source, source + numToCopy, dest + i);
+            }
+
+            position = (position + numToCopy) & mMask;
+            i += numToCopy;
+        }
+    }
+
+    template <typename ElementType>
+    static void clearPages (PagedBuffer<ElementType>& pages) noexcept {
+        for (int page = 0; page < pages.getNumPages(); page++) {
+            if (pages.isAllocated(page)) {
+                ElementType* data = pages.getPageForWriting(page);
+                std::fill(data, data + PagedBuffer<ElementType>::pageSize, ElementType());
+            }
+        }
+    }
+
+    //==============================================================================
+    SampleType readFractionalWithKernel (SampleType delayInSamples) noexcept {
+        const SampleType* buffer = mBuffer.data();
+
+        switch (mInterpolation) {
+            case Interpolation::hermite:    return interpolate<HermiteInterpolator<SampleType>>(buffer, mMask, mWriteHead, delayInSamples);
+            case Interpolation::lagrange:   return interpolate<LagrangeInterpolator<SampleType>>(buffer, mMask, mWriteHead, delayInSamples);
+            case Interpolation::thiran:     return interpolateAllpass(buffer, mMask, mWriteHead, delayInSamples);
+            case Interpolation::sinc8:      return interpolate<SincInterpolator<SampleType, 8>>(buffer, mMask, mWriteHead, delayInSamples);
+            case Interpolation::sinc16:     return interpolate<SincInterpolator<SampleType, 16>>(buffer, mMask, mWriteHead, delayInSamples);
+            default:                        return interpolate<LinearInterpolator<SampleType>>(buffer, mMask, mWriteHead, delayInSamples);
+        }
+    }
+
+    /** Where a kernel's oldest tap sits for a read of delayInSamples back from writeHead.
+        The whole and fractional parts of the delay are split before they meet the
+        write head, which keeps the full precision of the fraction and needs a
+        truncation rather than a call to floor().
+     */
+    template <typename Kernel>
+    static int getFirstTap (int mask, int writeHead, int wholeDelay) noexcept {
+        return (writeHead - wholeDelay - (Kernel::numTaps - 1 - Kernel::numNewerTaps)) & mask;
+    }
+
+    template <typename Kernel>
+    static SampleType interpolate (const SampleType* buffer, int mask, int writeHead, SampleType delayInSamples) noexcept {
+        const int wholeDelay = (int) delayInSamples;
+        const SampleType fraction = delayInSamples - (SampleType) wholeDelay;
+
+        // The taps sit side by side, even across the end of the buffer
+        return Kernel::process(buffer + getFirstTap<Kernel>(mask, writeHead, wholeDelay), fraction);
+    }
+
+    /** Reads the block from sample startSample on, one sample at a time. The sinc kernels are still vectorised inside. */
+    template <typename Kernel>
+    static void readBlock (const SampleType* buffer, int mask, int firstWriteHead,
+                           const SampleType* delayInSamples, SampleType* dest, int numSamples, int startSample = 0) noexcept {
+        for (int i = startSample; i < numSamples; i++) {
+            dest[i] = interpolate<Kernel>(buffer, mask, firstWriteHead + i, delayInSamples[i]);
+        }
+    }
+
+    /** Reads as much of the block as it can four outputs at a time, and the rest one at a time. */
+    template <typename Kernel>
+    static void readBlockFourAtATime (const SampleType* buffer, int mask, int firstWriteHead,
+                                      const SampleType* delayInSamples, SampleType* dest, int numSamples) noexcept {
+        const int numRead = interpolateFourAtATime<Kernel>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples);
+        readBlock<Kernel>(buffer, mask, firstWriteHead, delayInSamples, dest, numSamples, numRead);
+    }
+
+    template <typename Kernel>
+    static void convolveBlock (const SampleType* buffer, int mask, int firstWriteHead,
+                               SampleType delayInSamples, SampleType* dest, int numSamples) noexcept {
+        const int wholeDelay = (int) delayInSamples;
+
+        SampleType c[Kernel::numTaps];
+        Kernel::getCoefficients(delayInSamples - (SampleType) wholeDelay, c);
+
+        int readHead = getFirstTap<Kernel>(mask, firstWriteHead, wholeDelay);
+
+        for (int i = 0; i < numSamples;) {
+            const int numBeforeEnd = std::min(numSamples - i, mask + 1 - readHead);
+            const SampleType* x = buffer + readHead;
+            SampleType* out = dest + i;
+
+            for (int j = 0; j < numBeforeEnd; j++) {
+                SampleType sum = c[0] * x[j];
+
+                for (int k = 1; k < Kernel::numTaps; k++) {
+                    sum += c[k] * x[j + k];
+                }
+
+                out[j] = sum;
+            }
+
+            i += numBeforeEnd;
+            readHead = 0;
+        }
+    }
+
+    /** First-order Thiran allpass. The whole part is chosen so the allpass makes up
+        between 0.5 and 1.5 samples of the delay, where its phase delay is flattest
+        and its coefficient stays well clear of the unit circle.
+     */
+    SampleType interpolateAllpass (const SampleType* buffer, int mask, int writeHead, SampleType delayInSamples) noexcept {
+        int wholeDelay = (int) delayInSamples;
+        SampleType fraction = delayInSamples - (SampleType) wholeDelay;
+
+        if (fraction < (SampleType) 0.5) {
+            wholeDelay--;
+            fraction += 1;
+        }
+
+        const SampleType coefficient = (1 - fraction) / (1 + fraction);
+        const SampleType* x = buffer + ((writeHead - wholeDelay - 1) & mask);
+
+        // x[1] is the newer of the pair
+        mAllpassState = coefficient * (x[1] - mAllpassState) + x[0];
+        return mAllpassState;
+    }
+
+    ArenaVector<SampleType> mBuffer;
+    PagedBuffer<SampleType> mPages;
+    PagedBuffer<int16_t> mCompactPages;
+
+    Storage mStorage = Storage::native;
+    uint32_t mDitherCounter = 0;
+
+    // For paged storage: how many pages back from the write head's are kept, the oldest page
+    // that hasn't been given back yet, and how many samples of silence have been pushed in a row
+    int mReachInPages = 0;
+    int mReleaseHead = 0;
+    int mSilentRun = 0;
+
+    int mMask = 0;
+    int mGuardSize = 0;
+    int mWriteHead = 0;
+
+    Interpolation mInterpolation = Interpolation::linear;
+    SampleType mAllpassState = 0;
+
+};
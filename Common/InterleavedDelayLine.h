@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Arena.h"
+#include "Interpolation.h"
+
+//==============================================================================
+/**
+    A circular buffer of past samples for NumChannels channels that are always
+    read at the same delay, stored interleaved (LRLR...) instead of one buffer
+    per channel.
+
+    Every channel's sample for a moment in time sits in the same frame, so a tap
+    fetches all of them from one cache line, and the kernel's coefficients are
+    worked out once per output and applied to the whole frame as one
+    NumChannels-wide vector. Planar DelayLines touch one cache line per channel
+    per tap instead. Whether that wins depends on the machine: with one steady
+    delay both layouts read memory front to back, which prefetchers handle well.
+
+    Otherwise it works like DelayLine: the capacity is a power of two, the first
+    few frames are mirrored past the end so taps never wrap, and delays are in
+    samples. It only has the block reads, which need every delay to be longer
+    than the block plus getLookahead().
+ */
+template <typename SampleType, int NumChannels>
+class InterleavedDelayLine {
+
+public:
+
+    //==============================================================================
+    /** Makes room for reads up to maxDelayInSamples back, in the current Arena if there
+        is one, and clears the history. Not real-time safe.
+     */
+    void prepare (int maxDelayInSamples) {
+        const int numGuardFrames = SincInterpolator<SampleType, 16>::numTaps - 1;
+
+        // Build the sinc tables now rather than on the audio thread
+        SincInterpolator<SampleType, 8>::getTable();
+        SincInterpolator<SampleType, 16>::getTable();
+
+        int capacity = 1;
+
+        while (capacity < maxDelayInSamples + numGuardFrames + 1) {
+            capacity <<= 1;
+        }
+
+        mBuffer = ArenaVector<SampleType>((size_t) ((capacity + numGuardFrames) * NumChannels));
+        mMask = capacity - 1;
+        mGuardSize = numGuardFrames;
+        mWriteHead = 0;
+        std::fill(mAllpassState, mAllpassState + NumChannels, SampleType());
+    }
+
+    /** Clears the history without reallocating. */
+    void clear() noexcept {
+        std::fill(mBuffer.begin(), mBuffer.end(), SampleType());
+        std::fill(mAllpassState, mAllpassState + NumChannels, SampleType());
+    }
+
+    /** Picks the kernel for fractional reads. Real-time safe. */
+    void setInterpolation (Interpolation interpolation) noexcept {
+        if (interpolation != mInterpolation) {
+            mInterpolation = interpolation;
+            std::fill(mAllpassState, mAllpassState + NumChannels, SampleType());
+        }
+    }
+
+    Interpolation getInterpolation() const noexcept     { return mInterpolation; }
+
+    /** The same as DelayLine's, one channel at a time, for read heads sharing the delay line. */
+    SampleType getAllpassState (int channel) const noexcept             { return mAllpassState[channel]; }
+    void setAllpassState (int channel, SampleType state) noexcept       { mAllpassState[channel] = state; }
+
+    /** How many samples newer than the whole part of the delay the current kernel reads. */
+    int getLookahead() const noexcept                   { return getInterpolationLookahead(mInterpolation); }
+
+    /** The longest delay that the reads can reach. */
+    int getMaxDelay() const noexcept                    { return mMask - mGuardSize; }
+
+    //==============================================================================
+    /** Pushes numSamples from each of the NumChannels arrays, interleaving them as it goes.
+        numSamples must be no more than the capacity.
+     */
+    void pushBlock (const SampleType* const* channels, int numSamples) noexcept {
+        const int start = (mWriteHead + 1) & mMask;
+        const int numBeforeEnd = std::min(numSamples, mMask + 1 - start);
+
+        interleave(channels, 0, numBeforeEnd, mBuffer.data() + start * NumChannels);
+        interleave(channels, numBeforeEnd, numSamples, mBuffer.data());
+
+        // Refresh the mirrored copy if the block touched the start of the buffer
+        if (start < mGuardSize || numBeforeEnd < numSamples) {
+            std::copy(mBuffer.data(), mBuffer.data() + mGuardSize * NumChannels, mBuffer.data() + (mMask + 1) * NumChannels);
+        }
+
+        mWriteHead = (mWriteHead + numSamples) & mMask;
+    }
+
+    /** Moves the write head on by numSamples frames of silence, the same as DelayLine::advance(). */
+    void advance (int numSamples) noexcept {
+        const int start = (mWriteHead + 1) & mMask;
+        const int numToClear = std::min(numSamples, mMask + 1);
+        const int numBeforeEnd = std::min(numToClear, mMask + 1 - start);
+
+        std::fill(mBuffer.data() + start * NumChannels, mBuffer.data() + (start + numBeforeEnd) * NumChannels, SampleType());
+        std::fill(mBuffer.data(), mBuffer.data() + (numToClear - numBeforeEnd) * NumChannels, SampleType());
+
+        if (start < mGuardSize || numBeforeEnd < numToClear) {
+            std::copy(mBuffer.data(), mBuffer.data() + mGuardSize * NumChannels, mBuffer.data() + (mMask + 1) * NumChannels);
+        }
+
+        mWriteHead = (mWriteHead + numSamples) & mMask;
+        std::fill(mAllpassState, mAllpassState + NumChannels, SampleType());
+    }
+
+    /** Reads a block into NumChannels arrays, with a delay per sample that every channel
+        shares. Sample i is read as if the first i + 1 samples of the block had been
+        pushed, the same as DelayLine::readFractionalBlock(). Call it before pushBlock().
+     */
+    void readFractionalBlock (const SampleType* delayInSamples, SampleType* const* dest, int numSamples) noexcept {
+        switch (mInterpolation) {
+            case Interpolation::hermite:    readBlock<HermiteInterpolator<SampleType>>(delayInSamples, dest, numSamples); break;
+            case Interpolation::lagrange:   readBlock<LagrangeInterpolator<SampleType>>(delayInSamples, dest, numSamples); break;
+            case Interpolation::thiran:     readBlockAllpass(dest, numSamples, [delayInSamples] (int i) { return delayInSamples[i]; }); break;
+            case Interpolation::sinc8:      readBlockGathered<SincInterpolator<SampleType, 8>>(delayInSamples, dest, numSamples); break;
+            case Interpolation::sinc16:     readBlockGathered<SincInterpolator<SampleType, 16>>(delayInSamples, dest, numSamples); break;
+            case Interpolation::linear:     readBlock<LinearInterpolator<SampleType>>(delayInSamples, dest, numSamples); break;
+        }
+    }
+
+    /** Reads a block at one delay for the whole block, which only needs the kernel's coefficients once. */
+    void readFractionalBlock (SampleType delayInSamples, SampleType* const* dest, int numSamples) noexcept {
+        switch (mInterpolation) {
+            case Interpolation::hermite:    convolveBlock<HermiteInterpolator<SampleType>>(delayInSamples, dest, numSamples); break;
+            case Interpolation::lagrange:   convolveBlock<LagrangeInterpolator<SampleType>>(delayInSamples, dest, numSamples); break;
+            case Interpolation::sinc8:      convolveBlock<SincInterpolator<SampleType, 8>>(delayInSamples, dest, numSamples); break;
+            case Interpolation::sinc16:     convolveBlock<SincInterpolator<SampleType, 16>>(delayInSamples, dest, numSamples); break;
+            case Interpolation::linear:     convolveBlock<LinearInterpolator<SampleType>>(delayInSamples, dest, numSamples); break;
+            case Interpolation::thiran:     readBlockAllpass(dest, numSamples, [delayInSamples] (int) { return delayInSamples; }); break;
+        }
+    }
+
+private:
+
+    /** Where a kernel's oldest tap sits for output i of a block, counted in frames. */
+    template <typename Kernel>
+    int getFirstTap (int i, int wholeDelay) const noexcept {
+        return (mWriteHead + 1 + i - wholeDelay - (Kernel::numTaps - 1 - Kernel::numNewerTaps)) & mMask;
+    }
+
+    /** Applies one set of coefficients to the frames starting at x, one multiply-add per tap across all the channels. */
+    template <typename Kernel>
+    static void convolveFrame (const SampleType* c, const SampleType* x, SampleType* const* dest, int i) noexcept {
+        SampleType sum[NumChannels];
+
+        for (int channel = 0; channel < NumChannels; channel++) {
+            sum[channel] = c[0] * x[channel];
+        }
+
+        for (int k = 1; k < Kernel::numTaps; k++) {
+            for (int channel = 0; channel < NumChannels; channel++) {
+                sum[channel] += c[k] * x[k * NumChannels + channel];
+            }
+        }
+
+        for (int channel = 0; channel < NumChannels; channel++) {
+            dest[channel][i] = sum[channel];
+        }
+    }
+
+    void interleave (const SampleType* const* channels, int startSample, int endSample, SampleType* frames) noexcept {
+        for (int channel = 0; channel < NumChannels; channel++) {
+            const SampleType* samples = channels[channel];
+
+            for (int i = startSample; i < endSample; i++) {
+                frames[(i - startSample) * NumChannels + channel] = samples[i];
+            }
+        }
+    }
+
+    template <typename Kernel>
+    void readBlock (const SampleType* delayInSamples, SampleType* const* dest, int numSamples) const noexcept {
+        for (int i = 0; i < numSamples; i++) {
+            const int wholeDelay = (int) delayInSamples[i];
+
+            SampleType c[Kernel::numTaps];
+            Kernel::getCoefficients(delayInSamples[i] - (SampleType) wholeDelay, c);
+
+            convolveFrame<Kernel>(c, mBuffer.data() + getFirstTap<Kernel>(i, wholeDelay) * NumChannels, dest, i);
+        }
+    }
+
+    /** The sinc kernels' process() adds its taps up in vector lanes, which is a different order from
+        convolveFrame(), so for the same output as DelayLine each channel's taps are gathered into a
+        run of their own and read with process() too. They're still all in the same few cache lines.
+     */
+    template <typename Kernel>
+    void readBlockGathered (const SampleType* delayInSamples, SampleType* const* dest, int numSamples) const noexcept {
+        for (int i = 0; i < numSamples; i++) {
+            const int wholeDelay = (int) delayInSamples[i];
+            const SampleType fraction = delayInSamples[i] - (SampleType) wholeDelay;
+            const SampleType* x = mBuffer.data() + getFirstTap<Kernel>(i, wholeDelay) * NumChannels;
+
+            for (int channel = 0; channel < NumChannels; channel++) {
+                SampleType taps[Kernel::numTaps];
+
+                for (int k = 0; k < Kernel::numTaps; k++) {
+                    taps[k] = x[k * NumChannels + channel];
+                }
+
+                dest[channel][i] = Kernel::process(taps, fraction);
+            }
+        }
+    }
+
+    /** With one delay for the block, the taps for every channel are a whole number of
+        frames apart, so the interleaved history can be convolved as one long run of
+        samples, the same way DelayLine does. Each tile of output is then split back out
+        into the channels.
+     */
+    template <typename Kernel>
+    void convolveBlock (SampleType delayInSamples, SampleType* const* dest, int numSamples) const noexcept {
+        const int wholeDelay = (int) delayInSamples;
+
+        SampleType c[Kernel::numTaps];
+        Kernel::getCoefficients(delayInSamples - (SampleType) wholeDelay, c);
+
+        constexpr int numTileFrames = 64;
+        SampleType tile[numTileFrames * NumChannels];
+
+        int readHead = getFirstTap<Kernel>(0, wholeDelay);
+
+        for (int i = 0; i < numSamples;) {
+            const int numFrames = std::min({ numTileFrames, numSamples - i, mMask + 1 - readHead });
+            const SampleType* x = mBuffer.data() + readHead * NumChannels;
+
+            for (int j = 0; j < numFrames * NumChannels; j++) {
+                SampleType sum = c[0] * x[j];
+
+                for (int k = 1; k < Kernel::numTaps; k++) {
+                    sum += c[k] * x[j + k * NumChannels];
+                }
+
+                tile[j] = sum;
+            }
+
+            for (int channel = 0; channel < NumChannels; channel++) {
+                SampleType* out = dest[channel] + i;
+
+                for (int j = 0; j < numFrames; j++) {
+                    out[j] = tile[j * NumChannels + channel];
+                }
+            }
+
+            i += numFrames;
+            readHead = (readHead + numFrames) & mMask;
+        }
+    }
+
+    /** First-order Thiran allpass, the same as DelayLine's, with one state per channel.
+        It feeds each output into the next, so constant delays can't skip any work.
+     */
+    template <typename DelayAt>
+    void readBlockAllpass (SampleType* const* dest, int numSamples, DelayAt delayAt) noexcept {
+        for (int i = 0; i < numSamples; i++) {
+            int wholeDelay = (int) delayAt(i);
+            SampleType fraction = delayAt(i) - (SampleType) wholeDelay;
+
+            if (fraction < (SampleType) 0.5) {
+                wholeDelay--;
+                fraction += 1;
+            }
+
+            const SampleType coefficient = (1 - fraction) / (1 + fraction);
+            const SampleType* x = mBuffer.data() + ((mWriteHead + 1 + i - wholeDelay - 1) & mMask) * NumChannels;
+
+            // The frame after x is the newer of the pair
+            for (int channel = 0; channel < NumChannels; channel++) {
+                mAllpassState[channel] = coefficient * (x[NumChannels + channel] - mAllpassState[channel]) + x[channel];
+                dest[channel][i] = mAllpassState[channel];
+            }
+        }
+    }
+
+    ArenaVector<SampleType> mBuffer;
+
+    int mMask = 0;
+    int mGuardSize = 0;
+    int mWriteHead = 0;
+
+    Interpolation mInterpolation = Interpolation::linear;
+    SampleType mAllpassState[NumChannels] = {};
+
+};
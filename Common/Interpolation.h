@@ -0,0 +1,429 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "SIMD.h"
+
+//==============================================================================
+/**
+    The ways DelayLine can read between samples, from cheapest to best sounding.
+
+    Linear dulls the top end and smears comb filter notches. Cubic Hermite and
+    4th-order Lagrange are the usual compromise for modulated delays. The Thiran
+    allpass has a flat magnitude response, but is recursive, so it suits slowly
+    moving delays. The windowed sincs are for offline renders where CPU doesn't
+    matter.
+ */
+enum class Interpolation {
+    linear,
+    hermite,
+    lagrange,
+    thiran,
+    sinc8,
+    sinc16
+};
+
+//==============================================================================
+/*
+    Every non-recursive kernel below reads numTaps consecutive samples, oldest
+    first. numNewerTaps of them are more recent than the sample at the whole
+    part of the delay, so the delay can't be shorter than that. fraction is how
+    far back from that sample the read sits, from 0 to 1.
+
+    process() is a single read. getCoefficients() gives the weights for a
+    fraction that stays put, so a block can be read with one convolution.
+    The short kernels also have processFour(), which reads four outputs at once
+    with SSE2 after transposing their taps into one register per tap, and
+    processTwo(), which does the same for two doubles.
+ */
+
+template <typename SampleType>
+struct LinearInterpolator {
+    static constexpr int numTaps = 2;
+    static constexpr int numNewerTaps = 0;
+
+    static void getCoefficients (SampleType fraction, SampleType* c) noexcept {
+        c[0] = fraction;
+        c[1] = 1 - fraction;
+    }
+
+    static SampleType process (const SampleType* x, SampleType fraction) noexcept {
+        return fraction * x[0] + (1 - fraction) * x[1];
+    }
+
+   #if COMMON_SIMD_SSE2
+    static __m128 processFour (__m128 x0, __m128 x1, __m128, __m128, __m128, __m128 fraction) noexcept {
+        const __m128 oneMinusFraction = _mm_sub_ps(_mm_set1_ps(1.0f), fraction);
+        return _mm_add_ps(_mm_mul_ps(fraction, x0), _mm_mul_ps(oneMinusFraction, x1));
+    }
+
+    static __m128d processTwo (__m128d x0, __m128d x1, __m128d, __m128d, __m128d, __m128d fraction) noexcept {
+        const __m128d oneMinusFraction = _mm_sub_pd(_mm_set1_pd(1.0), fraction);
+        return _mm_add_pd(_mm_mul_pd(fraction, x0), _mm_mul_pd(oneMinusFraction, x1));
+    }
+   #endif
+};
+
+/** Catmull-Rom flavoured cubic Hermite spline through the middle two of four taps. */
+template <typename SampleType>
+struct HermiteInterpolator {
+    static constexpr int numTaps = 4;
+    static constexpr int numNewerTaps = 1;
+
+    static void getCoefficients (SampleType fraction, SampleType* c) noexcept {
+        // Position between the middle two taps, counting from the older one
+        const SampleType mu = 1 - fraction;
+        const SampleType mu2 = mu * mu;
+        const SampleType mu3 = mu2 * mu;
+        const SampleType half = (SampleType) 0.5;
+
+        c[0] = half * (2 * mu2 - mu - mu3);
+        c[1] = half * (3 * mu3 - 5 * mu2 + 2);
+        c[2] = half * (4 * mu2 + mu - 3 * mu3);
+        c[3] = half * (mu3 - mu2);
+    }
+
+    static SampleType process (const SampleType* x, SampleType fraction) noexcept {
+        SampleType c[numTaps];
+        getCoefficients(fraction, c);
+
+        return c[0] * x[0] + c[1] * x[1] + c[2] * x[2] + c[3] * x[3];
+    }
+
+   #if COMMON_SIMD_SSE2
+    static __m128 processFour (__m128 x0, __m128 x1, __m128 x2, __m128 x3, __m128, __m128 fraction) noexcept {
+        const __m128 mu = _mm_sub_ps(_mm_set1_ps(1.0f), fraction);
+        const __m128 mu2 = _mm_mul_ps(mu, mu);
+        const __m128 mu3 = _mm_mul_ps(mu2, mu);
+        const __m128 half = _mm_set1_ps(0.5f);
+
+        const __m128 c0 = _mm_mul_ps(half, _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.0f), mu2), mu), mu3));
+        const __m128 c1 = _mm_mul_ps(half, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), mu3), _mm_mul_ps(_mm_set1_ps(5.0f), mu2)), _mm_set1_ps(2.0f)));
+        const __m128 c2 = _mm_mul_ps(half, _mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(4.0f), mu2), mu), _mm_mul_ps(_mm_set1_ps(3.0f), mu3)));
+        const __m128 c3 = _mm_mul_ps(half, _mm_sub_ps(mu3, mu2));
+
+        return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, x0), _mm_mul_ps(c1, x1)), _mm_mul_ps(c2, x2)), _mm_mul_ps(c3, x3));
+    }
+
+    static __m128d processTwo (__m128d x0, __m128d x1, __m128d x2, __m128d x3, __m128d, __m128d fraction) noexcept {
+        const __m128d mu = _mm_sub_pd(_mm_set1_pd(1.0), fraction);
+        const __m128d mu2 = _mm_mul_pd(mu, mu);
+        const __m128d mu3 = _mm_mul_pd(mu2, mu);
+        const __m128d half = _mm_set1_pd(0.5);
+
+        const __m128d c0 = _mm_mul_pd(half, _mm_sub_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(2.0), mu2), mu), mu3));
+        const __m128d c1 = _mm_mul_pd(half, _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(3.0), mu3), _mm_mul_pd(_mm_set1_pd(5.0), mu2)), _mm_set1_pd(2.0)));
+        const __m128d c2 = _mm_mul_pd(half, _mm_sub_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(4.0), mu2), mu), _mm_mul_pd(_mm_set1_pd(3.0), mu3)));
+        const __m128d c3 = _mm_mul_pd(half, _mm_sub_pd(mu3, mu2));
+
+        return _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(c0, x0), _mm_mul_pd(c1, x1)), _mm_mul_pd(c2, x2)), _mm_mul_pd(c3, x3));
+    }
+   #endif
+};
+
+/** 4th-order Lagrange polynomial through five taps, reading between the middle one and the one before it. */
+template <typename SampleType>
+struct LagrangeInterpolator {
+    static constexpr int numTaps = 5;
+    static constexpr int numNewerTaps = 2;
+
+    static void getCoefficients (SampleType fraction, SampleType* c) noexcept {
+        // Distances from the read position to each tap
+        const SampleType d0 = 2 - fraction;
+        const SampleType d1 = d0 - 1;
+        const SampleType d2 = d0 - 2;
+        const SampleType d3 = d0 - 3;
+        const SampleType d4 = d0 - 4;
+
+        c[0] = d1 * d2 * d3 * d4 * (SampleType) (1.0 / 24.0);
+        c[1] = d0 * d2 * d3 * d4 * (SampleType) (-1.0 / 6.0);
+        c[2] = d0 * d1 * d3 * d4 * (SampleType) (1.0 / 4.0);
+        c[3] = d0 * d1 * d2 * d4 * (SampleType) (-1.0 / 6.0);
+        c[4] = d0 * d1 * d2 * d3 * (SampleType) (1.0 / 24.0);
+    }
+
+    static SampleType process (const SampleType* x, SampleType fraction) noexcept {
+        SampleType c[numTaps];
+        getCoefficients(fraction, c);
+
+        return c[0] * x[0] + c[1] * x[1] + c[2] * x[2] + c[3] * x[3] + c[4] * x[4];
+    }
+
+   #if COMMON_SIMD_SSE2
+    static __m128 processFour (__m128 x0, __m128 x1, __m128 x2, __m128 x3, __m128 x4, __m128 fraction) noexcept {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 d0 = _mm_sub_ps(_mm_set1_ps(2.0f), fraction);
+        const __m128 d1 = _mm_sub_ps(d0, one);
+        const __m128 d2 = _mm_sub_ps(d0, _mm_set1_ps(2.0f));
+        const __m128 d3 = _mm_sub_ps(d0, _mm_set1_ps(3.0f));
+        const __m128 d4 = _mm_sub_ps(d0, _mm_set1_ps(4.0f));
+
+        const __m128 c0 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(d1, d2), d3), d4), _mm_set1_ps((float) (1.0 / 24.0)));
+        const __m128 c1 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(d0, d2), d3), d4), _mm_set1_ps((float) (-1.0 / 6.0)));
+        const __m128 c2 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(d0, d1), d3), d4), _mm_set1_ps((float) (1.0 / 4.0)));
+        const __m128 c3 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(d0, d1), d2), d4), _mm_set1_ps((float) (-1.0 / 6.0)));
+        const __m128 c4 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(d0, d1), d2), d3), _mm_set1_ps((float) (1.0 / 24.0)));
+
+        return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, x0), _mm_mul_ps(c1, x1)), _mm_mul_ps(c2, x2)), _mm_mul_ps(c3, x3)), _mm_mul_ps(c4, x4));
+    }
+
+    static __m128d processTwo (__m128d x0, __m128d x1, __m128d x2, __m128d x3, __m128d x4, __m128d fraction) noexcept {
+        const __m128d one = _mm_set1_pd(1.0);
+        const __m128d d0 = _mm_sub_pd(_mm_set1_pd(2.0), fraction);
+        const __m128d d1 = _mm_sub_pd(d0, one);
+        const __m128d d2 = _mm_sub_pd(d0, _mm_set1_pd(2.0));
+        const __m128d d3 = _mm_sub_pd(d0, _mm_set1_pd(3.0));
+        const __m128d d4 = _mm_sub_pd(d0, _mm_set1_pd(4.0));
+
+        const __m128d c0 = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_mul_pd(d1, d2), d3), d4), _mm_set1_pd(1.0 / 24.0));
+        const __m128d c1 = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_mul_pd(d0, d2), d3), d4), _mm_set1_pd(-1.0 / 6.0));
+        const __m128d c2 = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_mul_pd(d0, d1), d3), d4), _mm_set1_pd(1.0 / 4.0));
+        const __m128d c3 = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_mul_pd(d0, d1), d2), d4), _mm_set1_pd(-1.0 / 6.0));
+        const __m128d c4 = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_mul_pd(d0, d1), d2), d3), _mm_set1_pd(1.0 / 24.0));
+
+        return _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(c0, x0), _mm_mul_pd(c1, x1)), _mm_mul_pd(c2, x2)), _mm_mul_pd(c3, x3)), _mm_mul_pd(c4, x4));
+    }
+   #endif
+};
+
+/**
+    Kaiser-windowed sinc, read from a table of numPhases + 1 sets of coefficients
+    with linear interpolation between neighbouring sets. Each set is normalised
+    to unity gain at DC, so sweeping the fraction doesn't ripple the level.
+ */
+template <typename SampleType, int NumTaps>
+struct SincInterpolator {
+    static constexpr int numTaps = NumTaps;
+    static constexpr int numNewerTaps = NumTaps / 2 - 1;
+    static constexpr int numPhases = 256;
+
+    /** Builds the table the first time it's called, so call it once before real-time use. */
+    static const SampleType* getTable() {
+        static const std::array<SampleType, (numPhases + 1) * numTaps> table = buildTable();
+        return table.data();
+    }
+
+    static void getCoefficients (SampleType fraction, SampleType* c) noexcept {
+        const SampleType position = fraction * (SampleType) numPhases;
+        const int phase = (int) position;
+        const SampleType blend = position - (SampleType) phase;
+
+        const SampleType* a = getTable() + phase * numTaps;
+        const SampleType* b = a + numTaps;
+
+        for (int i = 0; i < numTaps; i++) {
+            c[i] = a[i] + blend * (b[i] - a[i]);
+        }
+    }
+
+    static SampleType process (const SampleType* x, SampleType fraction) noexcept {
+        const SampleType position = fraction * (SampleType) numPhases;
+        const int phase = (int) position;
+        const SampleType blend = position - (SampleType) phase;
+
+        const SampleType* a = getTable() + phase * numTaps;
+
+        return dotProduct(x, a, a + numTaps, blend);
+    }
+
+private:
+
+    static std::array<SampleType, (numPhases + 1) * numTaps> buildTable() {
+        std::array<SampleType, (numPhases + 1) * numTaps> table;
+
+        const double pi = 3.141592653589793;
+        const double beta = numTaps <= 8 ? 6.0 : 9.0;
+        const double halfWidth = numTaps / 2;
+
+        for (int phase = 0; phase <= numPhases; phase++) {
+            // Where the read sits, counting taps from the oldest
+            const double centre = halfWidth - (double) phase / numPhases;
+            double coefficients[numTaps];
+            double sum = 0;
+
+            for (int i = 0; i < numTaps; i++) {
+                const double x = i - centre;
+                const double sinc = x == 0 ? 1.0 : std::sin(pi * x) / (pi * x);
+                const double r = x / halfWidth;
+                const double window = std::abs(r) >= 1 ? 0.0 : besselI0(beta * std::sqrt(1 - r * r)) / besselI0(beta);
+
+                coefficients[i] = sinc * window;
+                sum += coefficients[i];
+            }
+
+            for (int i = 0; i < numTaps; i++) {
+                table[(size_t) (phase * numTaps + i)] = (SampleType) (coefficients[i] / sum);
+            }
+        }
+
+        return table;
+    }
+
+    /** Zeroth order modified Bessel function of the first kind, for the Kaiser window. */
+    static double besselI0 (double x) {
+        double sum = 1, term = 1;
+
+        for (int k = 1; k < 50 && term > 1.0e-12 * sum; k++) {
+            term *= (x / (2 * k)) * (x / (2 * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    /** Sum of x times the coefficients blended between rows a and b. */
+    template <typename Type>
+    static Type dotProduct (const Type* x, const Type* a, const Type* b, Type blend) noexcept {
+        Type sum = 0;
+
+        for (int i = 0; i < numTaps; i++) {
+            sum += x[i] * (a[i] + blend * (b[i] - a[i]));
+        }
+
+        return sum;
+    }
+
+   #if COMMON_SIMD_SSE2
+    /** Four taps per instruction. The tap count is a multiple of four, so there's no remainder. */
+    static float dotProduct (const float* x, const float* a, const float* b, float blend) noexcept {
+        const __m128 blendV = _mm_set1_ps(blend);
+        __m128 sum = _mm_setzero_ps();
+
+        for (int i = 0; i < numTaps; i += 4) {
+            const __m128 ai = _mm_loadu_ps(a + i);
+            const __m128 c = _mm_add_ps(ai, _mm_mul_ps(blendV, _mm_sub_ps(_mm_loadu_ps(b + i), ai)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(x + i), c));
+        }
+
+        // Horizontal add of the four lanes
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+
+        return _mm_cvtss_f32(sum);
+    }
+
+    /** Two taps per instruction for doubles. */
+    static double dotProduct (const double* x, const double* a, const double* b, double blend) noexcept {
+        const __m128d blendV = _mm_set1_pd(blend);
+        __m128d sum = _mm_setzero_pd();
+
+        for (int i = 0; i < numTaps; i += 2) {
+            const __m128d ai = _mm_loadu_pd(a + i);
+            const __m128d c = _mm_add_pd(ai, _mm_mul_pd(blendV, _mm_sub_pd(_mm_loadu_pd(b + i), ai)));
+            sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(x + i), c));
+        }
+
+        return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+    }
+   #endif
+};
+
+//==============================================================================
+/** How many samples newer than the whole part of the delay a kernel reads. Delays
+    must be at least this long, and block reads need every delay to be longer than
+    the block plus this. Thiran's pair of taps reaches one sample newer.
+ */
+inline int getInterpolationLookahead (Interpolation interpolation) noexcept {
+    switch (interpolation) {
+        case Interpolation::hermite:    return HermiteInterpolator<float>::numNewerTaps;
+        case Interpolation::lagrange:   return LagrangeInterpolator<float>::numNewerTaps;
+        case Interpolation::thiran:     return 1;
+        case Interpolation::sinc8:      return SincInterpolator<float, 8>::numNewerTaps;
+        case Interpolation::sinc16:     return SincInterpolator<float, 16>::numNewerTaps;
+        default:                        return LinearInterpolator<float>::numNewerTaps;
+    }
+}
+
+//==============================================================================
+/**
+    Reads four outputs at a time for the kernels with processFour(), and returns
+    how many samples it covered. Each output's taps are loaded as one unaligned
+    vector, then transposed so each register holds one tap for all four outputs.
+    firstWriteHead is the write head for the first output, which moves on by one
+    for each output after it. Doubles are read as two pairs of outputs, two
+    lanes to a register. Other sample types fall back to the scalar loop.
+ */
+#if COMMON_SIMD_SSE2
+template <typename Kernel>
+int interpolateFourAtATime (const float* buffer, int mask, int firstWriteHead,
+                            const float* delayInSamples, float* dest, int numSamples) noexcept {
+    const int offset = Kernel::numTaps - 1 - Kernel::numNewerTaps;
+    const __m128i maskV = _mm_set1_epi32(mask);
+    const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+
+    int i = 0;
+
+    for (; i + 4 <= numSamples; i += 4) {
+        const __m128 delay = _mm_loadu_ps(delayInSamples + i);
+        const __m128i wholeDelay = _mm_cvttps_epi32(delay);
+        const __m128 fraction = _mm_sub_ps(delay, _mm_cvtepi32_ps(wholeDelay));
+
+        const __m128i writeHeads = _mm_add_epi32(_mm_set1_epi32(firstWriteHead + i - offset), lanes);
+        const __m128i readHeads = _mm_and_si128(_mm_sub_epi32(writeHeads, wholeDelay), maskV);
+
+        alignas (16) int index[4];
+        _mm_store_si128((__m128i*) index, readHeads);
+
+        const float* x0 = buffer + index[0];
+        const float* x1 = buffer + index[1];
+        const float* x2 = buffer + index[2];
+        const float* x3 = buffer + index[3];
+
+        __m128 tap0 = _mm_loadu_ps(x0);
+        __m128 tap1 = _mm_loadu_ps(x1);
+        __m128 tap2 = _mm_loadu_ps(x2);
+        __m128 tap3 = _mm_loadu_ps(x3);
+        _MM_TRANSPOSE4_PS(tap0, tap1, tap2, tap3);
+
+        // Only the five-tap kernel looks at the fifth tap
+        const __m128 tap4 = Kernel::numTaps > 4 ? _mm_setr_ps(x0[4], x1[4], x2[4], x3[4]) : _mm_setzero_ps();
+
+        _mm_storeu_ps(dest + i, Kernel::processFour(tap0, tap1, tap2, tap3, tap4, fraction));
+    }
+
+    return i;
+}
+
+template <typename Kernel>
+int interpolateFourAtATime (const double* buffer, int mask, int firstWriteHead,
+                            const double* delayInSamples, double* dest, int numSamples) noexcept {
+    const int offset = Kernel::numTaps - 1 - Kernel::numNewerTaps;
+
+    int i = 0;
+
+    for (; i + 4 <= numSamples; i += 4) {
+        for (int pair = i; pair < i + 4; pair += 2) {
+            const __m128d delay = _mm_loadu_pd(delayInSamples + pair);
+            const __m128i wholeDelay = _mm_cvttpd_epi32(delay);
+            const __m128d fraction = _mm_sub_pd(delay, _mm_cvtepi32_pd(wholeDelay));
+
+            alignas (16) int whole[4];
+            _mm_store_si128((__m128i*) whole, wholeDelay);
+
+            const double* xa = buffer + ((firstWriteHead + pair - offset - whole[0]) & mask);
+            const double* xb = buffer + ((firstWriteHead + pair + 1 - offset - whole[1]) & mask);
+
+            // Two outputs' taps, two at a time, transposed into one register per tap
+            const __m128d a01 = _mm_loadu_pd(xa);
+            const __m128d b01 = _mm_loadu_pd(xb);
+            const __m128d a23 = _mm_loadu_pd(xa + 2);
+            const __m128d b23 = _mm_loadu_pd(xb + 2);
+
+            const __m128d tap4 = Kernel::numTaps > 4 ? _mm_setr_pd(xa[4], xb[4]) : _mm_setzero_pd();
+
+            _mm_storeu_pd(dest + pair, Kernel::processTwo(_mm_unpacklo_pd(a01, b01), _mm_unpackhi_pd(a01, b01),
+                                                          _mm_unpacklo_pd(a23, b23), _mm_unpackhi_pd(a23, b23),
+                                                          tap4, fraction));
+        }
+    }
+
+    return i;
+}
+#endif
+
+template <typename Kernel, typename SampleType>
+int interpolateFourAtATime (const SampleType*, int, int, const SampleType*, SampleType*, int) noexcept {
+    return 0;
+}
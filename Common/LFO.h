@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Arena.h"
+
+//==============================================================================
+/**
+    A low frequency oscillator that works a block at a time.
+
+    advance() steps a single phase through the block, storing where it was at
+    each sample. getBlock() then turns those phases into output for one channel,
+    with its own phase offset, so every channel follows the same clock. Both are
+    plain loops over arrays with no calls into libm, which the compiler can
+    vectorise.
+
+    The phase is kept in cycles (0 to 1) and carries on from one block to the
+    next. Changing the shape only changes how the phase is read, so it never
+    restarts the cycle.
+
+    The random shapes pick their values by hashing the cycle number, which keeps
+    offset channels on the same sequence and needs no state per channel.
+ */
+template <typename SampleType>
+class LFO {
+
+public:
+
+    enum class Shape {
+        sine,
+        triangle,
+        square,
+        sampleAndHold,
+        smoothedRandom
+    };
+
+    //==============================================================================
+    /** Allocates room for one block of phases, in the current Arena if there is one. Not real-time
+        safe, so call it from prepareToPlay().
+     */
+    void prepare (double sampleRate, int maxBlockSize) {
+        mInverseSampleRate = (SampleType) (1.0 / sampleRate);
+
+        mPhases = ArenaVector<SampleType>((size_t) std::max(1, maxBlockSize), SampleType());
+        mCycles = ArenaVector<uint32_t>((size_t) std::max(1, maxBlockSize), 0u);
+
+        reset();
+    }
+
+    /** Starts again from the beginning of the first cycle. */
+    void reset() noexcept {
+        mPhase = 0;
+        mCycle = 0;
+    }
+
+    void setShape (Shape shape) noexcept                { mShape = shape; }
+    Shape getShape() const noexcept                     { return mShape; }
+
+    //==============================================================================
+    /** Steps the phase through the next numSamples samples, at a per-sample rate in Hz.
+        numSamples must be no more than the maxBlockSize passed to prepare().
+     */
+    void advance (const SampleType* rateHz, int numSamples) noexcept {
+        SampleType* phases = mPhases.data();
+        uint32_t* cycles = mCycles.data();
+
+        for (int i = 0; i < numSamples; i++) {
+            phases[i] = mPhase;
+            cycles[i] = mCycle;
+
+            mPhase += rateHz[i] * mInverseSampleRate;
+
+            // Ensure the phase is bounded between 0 and 1
+            if (mPhase >= 1) {
+                mPhase -= 1;
+                mCycle++;
+            }
+        }
+
+        mNumSamples = numSamples;
+    }
+
+    /** Fills dest with the block from the last advance(), shifted by a per-sample phaseOffset in cycles from 0 to 1.
+        Every shape swings between -1 and 1.
+     */
+    void getBlock (SampleType* dest, const SampleType* phaseOffset) const noexcept {
+        render(dest, [phaseOffset] (int i) { return phaseOffset[i]; });
+    }
+
+    /** Fills dest with the block from the last advance(), shifted by a fixed phaseOffset in cycles from 0 to 1. */
+    void getBlock (SampleType* dest, SampleType phaseOffset = 0) const noexcept {
+        render(dest, [phaseOffset] (int) { return phaseOffset; });
+    }
+
+private:
+
+    template <typename PhaseOffset>
+    void render (SampleType* dest, PhaseOffset phaseOffset) const noexcept {
+        const SampleType* phases = mPhases.data();
+        const uint32_t* cycles = mCycles.data();
+
+        switch (mShape) {
+            case Shape::sine:
+                for (int i = 0; i < mNumSamples; i++) {
+                    dest[i] = sine(wrap(phases[i] + phaseOffset(i)));
+                }
+                break;
+
+            case Shape::triangle:
+                for (int i = 0; i < mNumSamples; i++) {
+                    dest[i] = triangle(wrap(phases[i] + phaseOffset(i)));
+                }
+                break;
+
+            case Shape::square:
+                for (int i = 0; i < mNumSamples; i++) {
+                    dest[i] = wrap(phases[i] + phaseOffset(i)) < (SampleType) 0.5 ? 1 : -1;
+                }
+                break;
+
+            case Shape::sampleAndHold:
+                for (int i = 0; i < mNumSamples; i++) {
+                    SampleType phase = phases[i] + phaseOffset(i);
+                    dest[i] = random(cycles[i] + (phase >= 1 ? 1u : 0u));
+                }
+                break;
+
+            case Shape::smoothedRandom:
+                for (int i = 0; i < mNumSamples; i++) {
+                    SampleType phase = phases[i] + phaseOffset(i);
+                    uint32_t cycle = cycles[i] + (phase >= 1 ? 1u : 0u);
+                    phase = wrap(phase);
+
+                    // Glide from this cycle's value to the next one with a smoothstep, so there's no corner at the joins
+                    SampleType glide = phase * phase * (3 - 2 * phase);
+                    SampleType from = random(cycle);
+                    dest[i] = from + glide * (random(cycle + 1) - from);
+                }
+                break;
+        }
+    }
+
+    /** Offsets only ever push the phase past 1 once, so wrapping it back is a single subtraction. */
+    static SampleType wrap (SampleType phase) noexcept {
+        return phase >= 1 ? phase - 1 : phase;
+    }
+
+    /** sin(2 * pi * phase), folded into the quarter cycle either side of zero and
+        approximated there with a Taylor series. The error is around 1e-7.
+     */
+    static SampleType sine (SampleType phase) noexcept {
+        // Centre the cycle on zero, then mirror the outer quarters back inside, since sin(pi - x) == sin(x)
+        SampleType x = phase >= (SampleType) 0.5 ? phase - 1 : phase;
+        x = x > (SampleType) 0.25 ? (SampleType) 0.5 - x : x;
+        x = x < (SampleType) -0.25 ? (SampleType) -0.5 - x : x;
+
+        x *= (SampleType) 6.283185307179586;
+        const SampleType x2 = x * x;
+
+        const SampleType c3 = (SampleType) (-1.0 / 6.0);
+        const SampleType c5 = (SampleType) (1.0 / 120.0);
+        const SampleType c7 = (SampleType) (-1.0 / 5040.0);
+        const SampleType c9 = (SampleType) (1.0 / 362880.0);
+        const SampleType c11 = (SampleType) (-1.0 / 39916800.0);
+
+        return x * (1 + x2 * (c3 + x2 * (c5 + x2 * (c7 + x2 * (c9 + x2 * c11)))));
+    }
+
+    /** Rises from 0 like the sine, peaks at a quarter cycle and bottoms out at three quarters. */
+    static SampleType triangle (SampleType phase) noexcept {
+        return 1 - 4 * std::abs(wrap(phase + (SampleType) 0.25) - (SampleType) 0.5);
+    }
+
+    /** A value from -1 to 1 for each cycle, from an integer hash of its number. */
+    static SampleType random (uint32_t cycle) noexcept {
+        cycle ^= cycle >> 16;
+        cycle *= 0x7feb352du;
+        cycle ^= cycle >> 15;
+        cycle *= 0x846ca68bu;
+        cycle ^= cycle >> 16;
+
+        return (SampleType) (cycle >> 8) * (SampleType) (2.0 / 16777216.0) - 1;
+    }
+
+    Shape mShape = Shape::sine;
+
+    SampleType mInverseSampleRate = 0;
+    SampleType mPhase = 0;
+    uint32_t mCycle = 0;
+
+    ArenaVector<SampleType> mPhases;
+    ArenaVector<uint32_t> mCycles;
+    int mNumSamples = 0;
+
+};
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Transparent huge pages are a Linux feature, asked for with madvise()
+#if defined (__linux__)
+ #include <sys/mman.h>
+ #define COMMON_MEMORY_POOL_HUGE_PAGES 1
+#else
+ #define COMMON_MEMORY_POOL_HUGE_PAGES 0
+#endif
+
+//==============================================================================
+/**
+    The big blocks of zeroed memory that every instance in the process keeps its
+    delay lines in: the arenas processors are prepared into, and the pages of
+    paged delay lines.
+
+    Block sizes are rounded up to one of four size classes an octave. A delay
+    line's size comes from the sample rate and the longest delay, so instances
+    prepared the same way land in the same class, and a block given back by one
+    is a fit for the next. Blocks that are given back are cleared by a thread of
+    the pool's own and kept for the next allocate(), up to maxPooledBytes in all,
+    so a session that removes a few dozen instances and adds them back doesn't go
+    to the heap at all, or clear anything while it loads. A block asked for before
+    the thread gets to it is cleared on the spot, and a new one is cleared as it's
+    allocated, so every block comes back zeroed with its pages already touched.
+
+    Blocks are only kept while something holds a MemoryPool::User, as every Arena
+    does. When the last one goes, like the last instance of a plugin, the thread
+    is stopped and everything kept is freed there and then, the way JUCE's
+    SharedResourcePointer lets go of its object, rather than when the process
+    exits. Blocks given back with no User left are freed straight away.
+ */
+class MemoryPool {
+
+public:
+
+    static constexpr size_t alignment = 64;
+    static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+    static constexpr size_t minBlockSize = 4096;
+    static constexpr size_t maxPooledBytes = (size_t) 512 * 1024 * 1024;
+
+    struct Block {
+        void* data;
+        size_t size;
+        bool isMapped;
+    };
+
+    /** The one pool every instance shares, made the first time it's asked for. */
+    static MemoryPool& getInstance() {
+        static MemoryPool pool;
+        return pool;
+    }
+
+    /** Keeps the pool's thread and the blocks it's kept alive for as long as it's held. */
+    class User {
+
+    public:
+
+        User()                                          { getInstance().addUser(); }
+        ~User()                                         { getInstance().removeUser(); }
+
+        User (const User&) = delete;
+        User& operator= (const User&) = delete;
+
+    };
+
+    ~MemoryPool() {
+        // The last User has stopped the thread already, unless one outlived everything else
+        stopAndFreeAll();
+    }
+
+    MemoryPool (const MemoryPool&) = delete;
+    MemoryPool& operator= (const MemoryPool&) = delete;
+
+    //==============================================================================
+    /** numBytes rounded up to its size class, 1, 1.25, 1.5 or 1.75 times a power of two,
+        and to a whole number of huge pages if it's big enough to be mapped.
+     */
+    static size_t getBlockSize (size_t numBytes, bool useHugePages) noexcept {
+        size_t size = minBlockSize;
+        size_t step = minBlockSize / 4;
+
+        while (size < numBytes) {
+            size += step;
+
+            if (size == 8 * step) {
+                step *= 2;
+            }
+        }
+
+        // Every size class from 8MB up is a whole number of huge pages already, and rounding
+        // the ones from 2MB to there up lands on 4, 6 or 8MB, so a block's size is always a class
+        if (COMMON_MEMORY_POOL_HUGE_PAGES && useHugePages && size >= hugePageSize) {
+            size = (size + hugePageSize - 1) & ~(hugePageSize - 1);
+        }
+
+        return size;
+    }
+
+    /** A zeroed block of getBlockSize(numBytes, useHugePages), 64-byte aligned. With useHugePages,
+        blocks of 2MB or more are mapped on a 2MB boundary on Linux and marked for transparent huge
+        pages, so the kernel can cover each one with a single TLB entry. Not real-time safe.
+     */
+    Block allocate (size_t numBytes, bool useHugePages = false) {
+        const size_t size = getBlockSize(numBytes, useHugePages);
+        const bool shouldMap = COMMON_MEMORY_POOL_HUGE_PAGES && useHugePages && size >= hugePageSize;
+        Block block;
+        bool isDirty;
+
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+
+            if (take(mClean, size, shouldMap, block)) {
+                return block;
+            }
+
+            isDirty = take(mDirty, size, shouldMap, block);
+        }
+
+        // Cleared without the lock, so other instances and the thread aren't held up meanwhile
+        if (! isDirty) {
+            block = allocateBlock(size, shouldMap);
+        }
+
+        std::memset(block.data, 0, block.size);
+        return block;
+    }
+
+    /** Hands a block from allocate() back to be cleared and used again, or frees it if the pool
+        is full. Not real-time safe.
+     */
+    void release (const Block& block) noexcept {
+        if (block.data == nullptr) {
+            return;
+        }
+
+        try {
+            std::lock_guard<std::mutex> lock(mLock);
+
+            if (mNumUsers > 0 && ! mShouldStop && mNumPooledBytes + block.size <= maxPooledBytes) {
+                // Room for everything the thread might clear, and the block it may be clearing
+                // now, so it never allocates
+                mClean.reserve(mClean.size() + mDirty.size() + 2);
+                mDirty.push_back(block);
+                mNumPooledBytes += block.size;
+
+                if (! mThread.joinable()) {
+                    mThread = std::thread([this] { clearInBackground(); });
+                }
+
+                mDirtyAdded.notify_one();
+                return;
+            }
+        } catch (...) {
+            // Out of memory for the pool's own lists, or for a thread, so it's freed instead
+        }
+
+        freeBlock(block);
+    }
+
+private:
+
+    MemoryPool() = default;
+
+    void addUser() {
+        std::lock_guard<std::mutex> users(mUsersLock);
+        std::lock_guard<std::mutex> lock(mLock);
+        mNumUsers++;
+    }
+
+    void removeUser() noexcept {
+        std::lock_guard<std::mutex> users(mUsersLock);
+
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+
+            if (--mNumUsers > 0) {
+                return;
+            }
+        }
+
+        stopAndFreeAll();
+    }
+
+    /** Stops the thread, frees every block kept, and leaves the pool ready to start again. */
+    void stopAndFreeAll() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mShouldStop = true;
+        }
+
+        mDirtyAdded.notify_one();
+
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+
+        std::vector<Block> clean, dirty;
+
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            clean.swap(mClean);
+            dirty.swap(mDirty);
+            mNumPooledBytes = 0;
+            mShouldStop = false;
+        }
+
+        for (auto* blocks : { &clean, &dirty }) {
+            for (auto& block : *blocks) {
+                freeBlock(block);
+            }
+        }
+    }
+
+    /** Takes a block of the size and kind out of blocks, if there is one. Call with the lock held. */
+    bool take (std::vector<Block>& blocks, size_t size, bool isMapped, Block& block) noexcept {
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (blocks[i].size == size && blocks[i].isMapped == isMapped) {
+                block = blocks[i];
+                blocks[i] = blocks.back();
+                blocks.pop_back();
+                mNumPooledBytes -= size;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void clearInBackground() {
+        std::unique_lock<std::mutex> lock(mLock);
+
+        while (! mShouldStop) {
+            if (mDirty.empty()) {
+                mDirtyAdded.wait(lock);
+                continue;
+            }
+
+            Block block = mDirty.back();
+            mDirty.pop_back();
+
+            // Cleared without the lock, so allocate() can take other blocks meanwhile. It's out of
+            // the pool while it's cleared, so it's counted out too.
+            mNumPooledBytes -= block.size;
+            lock.unlock();
+            std::memset(block.data, 0, block.size);
+            lock.lock();
+
+            mClean.push_back(block);
+            mNumPooledBytes += block.size;
+        }
+    }
+
+    static Block allocateBlock (size_t size, bool shouldMap) {
+       #if COMMON_MEMORY_POOL_HUGE_PAGES
+        if (shouldMap) {
+            // Mapped a huge page too long, then trimmed at both ends to start on a huge page boundary
+            void* mapped = mmap(nullptr, size + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (mapped != MAP_FAILED) {
+                const uintptr_t start = (reinterpret_cast<uintptr_t>(mapped) + hugePageSize - 1) & ~(uintptr_t) (hugePageSize - 1);
+                const size_t head = start - reinterpret_cast<uintptr_t>(mapped);
+
+                if (head > 0) {
+                    munmap(mapped, head);
+                }
+
+                munmap(reinterpret_cast<void*>(start + size), hugePageSize - head);
+
+               #ifdef MADV_HUGEPAGE
+                madvise(reinterpret_cast<void*>(start), size, MADV_HUGEPAGE);
+               #endif
+
+                return { reinterpret_cast<void*>(start), size, true };
+            }
+        }
+       #else
+        (void) shouldMap;
+       #endif
+
+        void* memory = std::malloc(size + alignment);
+
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        // malloc() is at least 8-byte aligned, so there's always room before the boundary to say where it started
+        const uintptr_t aligned = (reinterpret_cast<uintptr_t>(memory) + alignment) & ~(uintptr_t) (alignment - 1);
+        reinterpret_cast<void**>(aligned)[-1] = memory;
+        return { reinterpret_cast<void*>(aligned), size, false };
+    }
+
+    static void freeBlock (const Block& block) noexcept {
+       #if COMMON_MEMORY_POOL_HUGE_PAGES
+        if (block.isMapped) {
+            munmap(block.data, block.size);
+            return;
+        }
+       #endif
+
+        std::free(static_cast<void**>(block.data)[-1]);
+    }
+
+    // Blocks waiting to be cleared, and blocks ready to go. The thread only starts once
+    // something is given back. mUsersLock keeps one User's arrival or departure, and
+    // the stopping it may lead to, from overlapping another's.
+    std::mutex mUsersLock;
+    std::mutex mLock;
+    std::condition_variable mDirtyAdded;
+    std::vector<Block> mClean;
+    std::vector<Block> mDirty;
+    size_t mNumPooledBytes = 0;
+    int mNumUsers = 0;
+    bool mShouldStop = false;
+    std::thread mThread;
+
+};
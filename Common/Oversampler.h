@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "Arena.h"
+
+//==============================================================================
+/**
+    A linear-phase half-band lowpass for doubling or halving the sample rate of
+    one channel, split into its two polyphase branches.
+
+    Every other tap of a half-band filter is zero apart from the centre one,
+    which is a half. One branch is then just a delay, and the other holds the
+    NumSideTaps nonzero taps either side of the centre, which are symmetric, so
+    each output costs NumSideTaps multiplies. Both directions delay the signal
+    by getLatency() samples at the higher rate. Each direction keeps its own
+    history, so use one filter for the way up and another for the way down.
+
+    The taps are a Kaiser-windowed sinc with beta 9, which is flat to within
+    0.001 dB up to 40% of the higher rate's Nyquist frequency. With 16 side
+    taps it's down more than 90 dB from 60%, and with 8 side taps from 75%.
+ */
+template <typename SampleType, int NumSideTaps>
+class HalfBandFilter {
+
+public:
+
+    /** The delay through either direction, in samples at the higher rate. */
+    static constexpr int getLatency() noexcept          { return 2 * NumSideTaps - 1; }
+
+    //==============================================================================
+    /** Allocates room for blocks of up to maxBlockSize samples at the lower rate, in the
+        current Arena if there is one, and clears the history. Not real-time safe.
+     */
+    void prepare (int maxBlockSize) {
+        getTaps();
+
+        mInput = ArenaVector<SampleType>((size_t) (historySize + maxBlockSize), SampleType());
+        mOdd = ArenaVector<SampleType>((size_t) (NumSideTaps + maxBlockSize), SampleType());
+        mSum = ArenaVector<SampleType>((size_t) maxBlockSize, SampleType());
+    }
+
+    /** Clears the history. Only the samples carried over from the block before are read again,
+        so the rest of the block-sized buffers are left as they are.
+     */
+    void reset() noexcept {
+        std::fill_n(mInput.begin(), std::min(mInput.size(), (size_t) historySize), SampleType());
+        std::fill_n(mOdd.begin(), std::min(mOdd.size(), (size_t) NumSideTaps), SampleType());
+    }
+
+    //==============================================================================
+    /** Doubles the rate of numSamples samples, writing 2 * numSamples into dest. */
+    void upsample (const SampleType* source, SampleType* dest, int numSamples) noexcept {
+        SampleType* x = mInput.data();
+        std::copy(source, source + numSamples, x + historySize);
+
+        // The filtered branch, one tap pair at a time, so the loops over the block vectorise.
+        // The input is zero stuffed, which would halve the level, so the taps are doubled.
+        convolveSideTaps(x, numSamples);
+
+        for (int i = 0; i < numSamples; i++) {
+            dest[2 * i] = 2 * mSum[(size_t) i];
+            dest[2 * i + 1] = x[i + NumSideTaps];
+        }
+
+        std::copy(x + numSamples, x + numSamples + historySize, x);
+    }
+
+    /** Halves the rate of 2 * numSamples samples, writing numSamples into dest. */
+    void downsample (const SampleType* source, SampleType* dest, int numSamples) noexcept {
+        SampleType* even = mInput.data();
+        SampleType* odd = mOdd.data();
+
+        for (int i = 0; i < numSamples; i++) {
+            even[historySize + i] = source[2 * i];
+            odd[NumSideTaps + i] = source[2 * i + 1];
+        }
+
+        // The odd samples only pass through the centre tap
+        convolveSideTaps(even, numSamples);
+
+        for (int i = 0; i < numSamples; i++) {
+            dest[i] = mSum[(size_t) i] + (SampleType) 0.5 * odd[i];
+        }
+
+        std::copy(even + numSamples, even + numSamples + historySize, even);
+        std::copy(odd + numSamples, odd + numSamples + NumSideTaps, odd);
+    }
+
+private:
+
+    static constexpr int historySize = 2 * NumSideTaps - 1;
+
+    /** The side taps, nearest the centre first, normalised so the whole filter has unity gain at DC. */
+    static const SampleType* getTaps() {
+        static const std::array<SampleType, NumSideTaps> taps = buildTaps();
+        return taps.data();
+    }
+
+    static std::array<SampleType, NumSideTaps> buildTaps() {
+        const double pi = 3.141592653589793;
+        const double beta = 9.0;
+        const double halfWidth = 2 * NumSideTaps;
+
+        double coefficients[NumSideTaps];
+        double sum = 0;
+
+        for (int i = 0; i < NumSideTaps; i++) {
+            const double x = 2 * i + 1;
+            const double r = x / halfWidth;
+
+            coefficients[i] = std::sin(pi * x / 2) / (pi * x) * besselI0(beta * std::sqrt(1 - r * r)) / besselI0(beta);
+            sum += coefficients[i];
+        }
+
+        // The centre tap gives half the DC gain and the side taps on both sides the other half
+        std::array<SampleType, NumSideTaps> taps;
+
+        for (int i = 0; i < NumSideTaps; i++) {
+            taps[(size_t) i] = (SampleType) (0.25 * coefficients[i] / sum);
+        }
+
+        return taps;
+    }
+
+    /** Zeroth order modified Bessel function of the first kind, for the Kaiser window. */
+    static double besselI0 (double x) {
+        double sum = 1, term = 1;
+
+        for (int k = 1; k < 50 && term > 1.0e-12 * sum; k++) {
+            term *= (x / (2 * k)) * (x / (2 * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    /** Sum of each side tap times the pair of samples it straddles, for every output in the block.
+        Output i is centred between x[i + NumSideTaps - 1] and x[i + NumSideTaps].
+     */
+    void convolveSideTaps (const SampleType* x, int numSamples) noexcept {
+        const SampleType* taps = getTaps();
+        SampleType* sum = mSum.data();
+
+        for (int i = 0; i < numSamples; i++) {
+            sum[i] = taps[0] * (x[i + NumSideTaps - 1] + x[i + NumSideTaps]);
+        }
+
+        for (int k = 1; k < NumSideTaps; k++) {
+            const SampleType tap = taps[k];
+            const SampleType* older = x + NumSideTaps - 1 - k;
+            const SampleType* newer = x + NumSideTaps + k;
+
+            for (int i = 0; i < numSamples; i++) {
+                sum[i] += tap * (older[i] + newer[i]);
+            }
+        }
+    }
+
+    // The last historySize input samples followed by the block. When downsampling,
+    // they're the even samples, and the odd ones go in mOdd.
+    ArenaVector<SampleType> mInput;
+    ArenaVector<SampleType> mOdd;
+    ArenaVector<SampleType> mSum;
+
+};
+
+//==============================================================================
+/**
+    Runs one channel at 2x or 4x its sample rate, with a cascade of half-band
+    filters: a long one between the host's rate and 2x, where the transition
+    band is narrow, and a short one between 2x and 4x, where the first filter
+    has already cleared everything but the wide gap around the host's Nyquist.
+
+    upsample() a block, process factor times as many samples, then
+    downsample() them back. The round trip delays the signal by getLatency()
+    samples at the host's rate, which is always a whole number: 31 at 2x, and
+    39 at 4x, where the second stage is padded by half a sample to round it up.
+    A factor of 1 just copies.
+ */
+template <typename SampleType>
+class Oversampler {
+
+public:
+
+    //==============================================================================
+    /** Sets the factor, which must be 1, 2 or 4, allocates room for blocks of up to
+        maxBlockSize samples at the host's rate, and clears the filters. Not real-time safe.
+     */
+    void prepare (int factor, int maxBlockSize) {
+        mFactor = factor;
+
+        mFirstStageUp.prepare(maxBlockSize);
+        mFirstStageDown.prepare(maxBlockSize);
+        mSecondStageUp.prepare(2 * maxBlockSize);
+        mSecondStageDown.prepare(2 * maxBlockSize);
+
+        mMiddle = ArenaVector<SampleType>((size_t) (factor == 4 ? 2 * maxBlockSize + 1 : 0), SampleType());
+    }
+
+    /** Clears the filters in use, as though they'd only ever had silence through them. */
+    void reset() noexcept {
+        if (mFactor >= 2) {
+            mFirstStageUp.reset();
+            mFirstStageDown.reset();
+        }
+
+        if (mFactor == 4) {
+            mSecondStageUp.reset();
+            mSecondStageDown.reset();
+            mMiddle[0] = SampleType();
+        }
+    }
+
+    int getFactor() const noexcept                      { return mFactor; }
+
+    /** The delay through upsample() and downsample(), in samples at the host's rate. */
+    int getLatency() const noexcept {
+        switch (mFactor) {
+            case 2:     return firstStageLatency;
+            case 4:     return firstStageLatency + (secondStageLatency + 1) / 2;
+            default:    return 0;
+        }
+    }
+
+    //==============================================================================
+    /** Writes getFactor() * numSamples samples into dest. */
+    void upsample (const SampleType* source, SampleType* dest, int numSamples) noexcept {
+        if (mFactor == 4) {
+            mFirstStageUp.upsample(source, mMiddle.data() + 1, numSamples);
+            mSecondStageUp.upsample(mMiddle.data() + 1, dest, 2 * numSamples);
+        } else if (mFactor == 2) {
+            mFirstStageUp.upsample(source, dest, numSamples);
+        } else {
+            std::copy(source, source + numSamples, dest);
+        }
+    }
+
+    /** Reads getFactor() * numSamples samples from source and writes numSamples into dest. */
+    void downsample (const SampleType* source, SampleType* dest, int numSamples) noexcept {
+        if (mFactor == 4) {
+            // mMiddle[0] holds the last 2x sample from the block before, which delays this
+            // block by one sample at 2x and makes the whole latency a whole number of samples
+            mSecondStageDown.downsample(source, mMiddle.data() + 1, 2 * numSamples);
+            mFirstStageDown.downsample(mMiddle.data(), dest, numSamples);
+            mMiddle[0] = mMiddle[(size_t) (2 * numSamples)];
+        } else if (mFactor == 2) {
+            mFirstStageDown.downsample(source, dest, numSamples);
+        } else {
+            std::copy(source, source + numSamples, dest);
+        }
+    }
+
+private:
+
+    static constexpr int firstStageLatency = HalfBandFilter<SampleType, 16>::getLatency();
+    static constexpr int secondStageLatency = HalfBandFilter<SampleType, 8>::getLatency();
+
+    int mFactor = 1;
+
+    HalfBandFilter<SampleType, 16> mFirstStageUp;
+    HalfBandFilter<SampleType, 16> mFirstStageDown;
+    HalfBandFilter<SampleType, 8> mSecondStageUp;
+    HalfBandFilter<SampleType, 8> mSecondStageDown;
+
+    // The 2x signal between the stages. On the way down, the first sample is the
+    // one carried over from the block before.
+    ArenaVector<SampleType> mMiddle;
+
+};
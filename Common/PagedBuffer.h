@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "MemoryPool.h"
+
+//==============================================================================
+/**
+    A power-of-two sized run of ElementType, split into pages that are only
+    allocated once something is written to them.
+
+    Every page starts out as one shared page of zeros, so reading an empty page
+    needs no checks and costs no memory. The audio thread never allocates or
+    frees: getPageForWriting() takes a page from the zeroed spares, and release()
+    leaves pages that are done with in a slot to be freed. service() does the
+    allocating and freeing, and should run every few milliseconds on another
+    thread. There are as many spares as prepare() is told the write head can
+    cross between two calls to it. If they run out anyway, because service() fell
+    that far behind, the write is dropped, and the page reads back as silence.
+    Pages come from the MemoryPool and go back to it, so while any Arena is
+    around they're shared with every other instance rather than the heap's.
+ */
+template <typename ElementType>
+class PagedBuffer {
+
+public:
+
+    static constexpr int pageBits = 14;
+    static constexpr int pageSize = 1 << pageBits;
+
+    PagedBuffer() = default;
+
+    ~PagedBuffer() {
+        freeAll();
+    }
+
+    PagedBuffer (PagedBuffer&& other) noexcept {
+        swap(other);
+    }
+
+    PagedBuffer& operator= (PagedBuffer&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    //==============================================================================
+    /** Makes room for capacity elements, which must be a power of two and at least a
+        page, and frees every page. maxWritesBetweenServices is the most elements written
+        between two calls to service(), which sets how many spares there are. They're
+        only allocated by the next service(), so a prepare() that's thrown away, like an
+        Arena pass, costs no pages. Not real-time safe, and service() mustn't run while it does.
+     */
+    void prepare (int capacity, int maxWritesBetweenServices) {
+        freeAll();
+
+        mNumPages = capacity / pageSize;
+        mPages.reset(new ElementType*[(size_t) mNumPages]);
+        std::fill(mPages.get(), mPages.get() + mNumPages, getZeroPage());
+
+        // A run of writes can start part way into one page and end part way into another. Pages
+        // are released at most as fast as they're written, plus the few that fall out of reach.
+        mNumSpares = std::max(minSpares, maxWritesBetweenServices / pageSize + 2);
+        mNumFreed = 2 * mNumSpares;
+
+        mSpares.reset(new std::atomic<ElementType*>[(size_t) mNumSpares]);
+        mFreed.reset(new std::atomic<ElementType*>[(size_t) mNumFreed]);
+
+        for (int i = 0; i < mNumFreed; i++) {
+            mFreed[i] = nullptr;
+        }
+
+        for (int i = 0; i < mNumSpares; i++) {
+            mSpares[i] = nullptr;
+        }
+    }
+
+    /** Tops the spares back up and gives released pages back to the pool. Not real-time safe, but safe to
+        call from any thread while the audio thread is using the buffer.
+     */
+    void service() {
+        if (mPages == nullptr) {
+            return;
+        }
+
+        for (int i = 0; i < mNumFreed; i++) {
+            freePage(mFreed[i].exchange(nullptr));
+        }
+
+        for (int i = 0; i < mNumSpares; i++) {
+            if (mSpares[i].load() == nullptr) {
+                ElementType* page = allocatePage();
+                ElementType* expected = nullptr;
+
+                if (! mSpares[i].compare_exchange_strong(expected, page)) {
+                    freePage(page);
+                }
+            }
+        }
+    }
+
+    int getNumPages() const noexcept                    { return mNumPages; }
+
+    //==============================================================================
+    /** The page, or the shared page of zeros if it hasn't been written yet. */
+    const ElementType* getPage (int page) const noexcept        { return mPages[page]; }
+
+    bool isAllocated (int page) const noexcept                  { return mPages[page] != getZeroPage(); }
+
+    /** The page, taking a spare for it if it hasn't been written yet. Returns nullptr if
+        there were no spares left. Real-time safe.
+     */
+    ElementType* getPageForWriting (int page) noexcept {
+        if (mPages[page] == getZeroPage()) {
+            for (int i = 0; i < mNumSpares; i++) {
+                if (ElementType* spare = mSpares[i].exchange(nullptr)) {
+                    mPages[page] = spare;
+                    break;
+                }
+            }
+        }
+
+        return mPages[page] != getZeroPage() ? mPages[page] : nullptr;
+    }
+
+    /** Hands the page back to be freed, and returns whether it could. It can't when every
+        slot for freed pages is still waiting for service(). Real-time safe.
+     */
+    bool release (int page) noexcept {
+        if (mPages[page] == getZeroPage()) {
+            return true;
+        }
+
+        for (int i = 0; i < mNumFreed; i++) {
+            ElementType* expected = nullptr;
+
+            if (mFreed[i].compare_exchange_strong(expected, mPages[page])) {
+                mPages[page] = getZeroPage();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+
+    // At least a few, which last the write head over a quarter of a second even at 192 kHz
+    static constexpr int minSpares = 4;
+
+    /** Shared by every buffer, and never written. Built by the first prepare(). */
+    static ElementType* getZeroPage() {
+        static std::vector<ElementType> zeros((size_t) pageSize, ElementType());
+        return zeros.data();
+    }
+
+    static ElementType* allocatePage() {
+        return static_cast<ElementType*>(MemoryPool::getInstance().allocate(pageSize * sizeof(ElementType)).data);
+    }
+
+    static void freePage (ElementType* page) noexcept {
+        if (page != nullptr) {
+            MemoryPool::getInstance().release({ page, MemoryPool::getBlockSize(pageSize * sizeof(ElementType), false), false });
+        }
+    }
+
+    void freeAll() noexcept {
+        if (mPages == nullptr) {
+            return;
+        }
+
+        for (int i = 0; i < mNumPages; i++) {
+            if (mPages[i] != getZeroPage()) {
+                freePage(mPages[i]);
+            }
+        }
+
+        for (int i = 0; i < mNumSpares; i++) {
+            freePage(mSpares[i].exchange(nullptr));
+        }
+
+        for (int i = 0; i < mNumFreed; i++) {
+            freePage(mFreed[i].exchange(nullptr));
+        }
+
+        mPages.reset();
+        mNumPages = 0;
+    }
+
+    void swap (PagedBuffer& other) noexcept {
+        std::swap(mPages, other.mPages);
+        std::swap(mSpares, other.mSpares);
+        std::swap(mFreed, other.mFreed);
+        std::swap(mNumPages, other.mNumPages);
+        std::swap(mNumSpares, other.mNumSpares);
+        std::swap(mNumFreed, other.mNumFreed);
+    }
+
+    // Only the audio thread touches the page table. The spares and freed pages are
+    // handed between it and service() one atomic slot at a time.
+    std::unique_ptr<ElementType*[]> mPages;
+    std::unique_ptr<std::atomic<ElementType*>[]> mSpares;
+    std::unique_ptr<std::atomic<ElementType*>[]> mFreed;
+    int mNumPages = 0;
+    int mNumSpares = 0;
+    int mNumFreed = 0;
+
+};
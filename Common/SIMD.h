@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define COMMON_SIMD_SSE2 1
+#else
+ #define COMMON_SIMD_SSE2 0
+#endif
+
+// GCC and Clang can compile single functions for a newer instruction set than the rest of the build
+#if (defined (__GNUC__) || defined (__clang__)) && (defined (__x86_64__) || defined (__i386__))
+ #define COMMON_SIMD_DISPATCH 1
+#else
+ #define COMMON_SIMD_DISPATCH 0
+#endif
+
+//==============================================================================
+/**
+    The instruction sets dispatchSIMD() can run code with, oldest first.
+
+    baseline is whatever the build targets: SSE2 on 64-bit x86, and plain scalar
+    code (or whatever the compiler vectorises for) everywhere else.
+ */
+enum class SIMDLevel {
+    baseline,
+    avx2,
+    avx512
+};
+
+inline const char* getSIMDLevelName (SIMDLevel level) noexcept {
+    switch (level) {
+        case SIMDLevel::avx2:       return "avx2";
+        case SIMDLevel::avx512:     return "avx512";
+        default:                    return COMMON_SIMD_SSE2 ? "sse2" : "scalar";
+    }
+}
+
+/** The best level this CPU and OS support, worked out from CPUID the first time it's asked for. */
+inline SIMDLevel getSupportedSIMDLevel() noexcept {
+   #if COMMON_SIMD_DISPATCH
+    static const SIMDLevel level = [] {
+        __builtin_cpu_init();
+
+       #if ! defined (__clang__)
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+            && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq")) {
+            return SIMDLevel::avx512;
+        }
+       #endif
+
+        return __builtin_cpu_supports("avx2") ? SIMDLevel::avx2 : SIMDLevel::baseline;
+    }();
+
+    return level;
+   #else
+    return SIMDLevel::baseline;
+   #endif
+}
+
+/** Caps the level dispatchSIMD() picks, e.g. to check the levels against each other. */
+inline std::atomic<int>& getMaxSIMDLevel() noexcept {
+    static std::atomic<int> maxLevel { (int) SIMDLevel::avx512 };
+    return maxLevel;
+}
+
+inline void setMaxSIMDLevel (SIMDLevel level) noexcept {
+    getMaxSIMDLevel().store((int) level);
+}
+
+/** The level dispatchSIMD() runs code with. */
+inline SIMDLevel getSIMDLevel() noexcept {
+    return (SIMDLevel) std::min((int) getSupportedSIMDLevel(), getMaxSIMDLevel().load(std::memory_order_relaxed));
+}
+
+//==============================================================================
+#if COMMON_SIMD_DISPATCH
+/*
+    flatten inlines everything the function calls into it, so the loops in the
+    lambda are compiled again for the function's instruction set, wherever they
+    came from.
+
+    FMA is kept out so every level gives exactly the same output. A fused
+    multiply-add rounds once instead of twice, and in a modulated delay that
+    last bit of the delay time is audible at around -75 dB. AVX-512 always
+    brings FMA with it, so GCC is told not to contract there. Clang has no way
+    to say that for one function, so it stops at AVX2.
+ */
+template <typename Function>
+__attribute__ ((target ("avx2"), flatten))
+void runAVX2 (Function& function) {
+    function();
+}
+
+#if ! defined (__clang__)
+template <typename Function>
+__attribute__ ((target ("avx2,avx512f,avx512vl,avx512bw,avx512dq"), optimize ("fp-contract=off"), flatten))
+void runAVX512 (Function& function) {
+    function();
+}
+#endif
+#endif
+
+/** Runs function() compiled for the best instruction set getSIMDLevel() allows.
+    Pass it a lambda holding the plain loops of a whole block, so the check only
+    happens once per block. On compilers that can't target single functions it
+    just calls function().
+ */
+template <typename Function>
+void dispatchSIMD (Function&& function) {
+   #if COMMON_SIMD_DISPATCH
+    switch (getSIMDLevel()) {
+       #if ! defined (__clang__)
+        case SIMDLevel::avx512:     runAVX512(function); return;
+       #endif
+        case SIMDLevel::avx2:       runAVX2(function); return;
+        default:                    break;
+    }
+   #endif
+
+    function();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+//==============================================================================
+/** Anything within this of zero counts as silence. That's -100 dBFS, below the dither
+    of a 16-bit file.
+ */
+static constexpr double silenceLevel = 1.0e-5;
+
+/** Whether all numSamples are within level of zero, silenceLevel unless it's given. A plain
+    loop that only ANDs comparisons together, so it vectorises, for whichever instruction set
+    it's dispatched to. Each one asks whether a sample is quiet rather than loud, so NaN, which
+    fails every comparison, and infinities count as sound.
+ */
+template <typename SampleType>
+inline bool isSilent (const SampleType* samples, int numSamples, SampleType level = (SampleType) silenceLevel) noexcept {
+    int isQuiet = 1;
+
+    for (int i = 0; i < numSamples; i++) {
+        isQuiet &= (int) (std::abs(samples[i]) <= level);
+    }
+
+    return isQuiet != 0;
+}
+
+/**
+    How long a feedback loop takes to fall silent once its input stops, in seconds.
+
+    Everything round the loop comes back loopGain times as loud every loopTime seconds,
+    so something at full scale takes log(silenceLevel) / log(loopGain) trips to fall
+    silent. The last of it then takes outputTime to be read out. Filters in the loop
+    only make it shorter. A loopGain of 1 or more never falls silent.
+ */
+inline double getFeedbackTailSeconds (double loopGain, double loopTime, double outputTime) noexcept {
+    if (loopGain >= 1) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    if (loopGain <= silenceLevel) {
+        return outputTime;
+    }
+
+    return std::ceil(std::log(silenceLevel) / std::log(loopGain)) * loopTime + outputTime;
+}
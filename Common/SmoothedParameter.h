@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Arena.h"
+
+//==============================================================================
+/**
+    A parameter value that's read once per block and glides towards it over a
+    smoothing time in milliseconds, so the glide sounds the same at any sample rate.
+
+    At the top of processBlock(), pass the parameter's current value to
+    setTargetValue(). The inner loop then reads getRamp(), which is a plain array
+    of per-sample values, instead of dereferencing the parameter every sample.
+
+    Linear ramps reach the target in exactly the smoothing time. Exponential ones
+    behave like a one-pole filter and get within 0.1% (-60 dB) of it in that time,
+    which is what gives the delay time its tape-like glide. They jump the rest of
+    the way once they're within the tolerance, a millionth of the target's size
+    unless the constructor is given one in the parameter's own units.
+ */
+template <typename SampleType>
+class SmoothedParameter {
+
+public:
+
+    enum class Ramp {
+        linear,
+        exponential
+    };
+
+    SmoothedParameter (double smoothingTimeMs = 20.0, Ramp ramp = Ramp::linear, SampleType tolerance = 0)
+        : mSmoothingTimeMs (smoothingTimeMs), mRamp (ramp), mTolerance (tolerance) {
+    }
+
+    //==============================================================================
+    /** Sets up the step size for the sample rate and allocates room for one block of ramp values,
+        in the current Arena if there is one. Not real-time safe, so call it from prepareToPlay().
+     */
+    void prepare (double sampleRate, int maxBlockSize) {
+        mStepsToTarget = std::max(1, (int) std::round(mSmoothingTimeMs * 0.001 * sampleRate));
+
+        // Per-sample coefficient that leaves 0.001 of the distance to go after mStepsToTarget samples
+        mCoefficient = (SampleType) (1.0 - std::pow(0.001, 1.0 / mStepsToTarget));
+
+        mRampValues = ArenaVector<SampleType>((size_t) std::max(1, maxBlockSize), SampleType());
+        setCurrentAndTargetValue(mTargetValue);
+    }
+
+    int getMaxBlockSize() const noexcept                { return (int) mRampValues.size(); }
+
+    //==============================================================================
+    /** Jumps straight to a value, e.g. when playback starts. */
+    void setCurrentAndTargetValue (SampleType value) noexcept {
+        mCurrentValue = mTargetValue = value;
+        mCountdown = 0;
+    }
+
+    /** Starts gliding towards a new value. Cheap enough to call every block with an unchanged value. */
+    void setTargetValue (SampleType value) noexcept {
+        if (value == mTargetValue) {
+            return;
+        }
+
+        mTargetValue = value;
+        mCountdown = mStepsToTarget;
+        mStep = (mTargetValue - mCurrentValue) / (SampleType) mStepsToTarget;
+    }
+
+    SampleType getCurrentValue() const noexcept         { return mCurrentValue; }
+    SampleType getTargetValue() const noexcept          { return mTargetValue; }
+    bool isSmoothing() const noexcept                   { return mCountdown > 0; }
+
+    //==============================================================================
+    /** Returns the values for the next numSamples samples and advances past them.
+        numSamples must be no more than the maxBlockSize passed to prepare().
+     */
+    const SampleType* getRamp (int numSamples) noexcept {
+        auto* values = mRampValues.data();
+
+        if (! isSmoothing()) {
+            std::fill(values, values + numSamples, mCurrentValue);
+            return values;
+        }
+
+        for (int i = 0; i < numSamples; i++) {
+            values[i] = getNextValue();
+        }
+
+        return values;
+    }
+
+    /** Advances numSamples without working out the values in between, e.g. for blocks that
+        aren't processed at all. Lands about where getRamp() would have.
+     */
+    void skip (int numSamples) noexcept {
+        if (! isSmoothing()) {
+            return;
+        }
+
+        if (mRamp == Ramp::linear) {
+            if (numSamples >= mCountdown) {
+                setCurrentAndTargetValue(mTargetValue);
+            } else {
+                mCurrentValue += mStep * (SampleType) numSamples;
+                mCountdown -= numSamples;
+            }
+
+            return;
+        }
+
+        // numSamples steps of the one-pole at once, then the same test for being close enough
+        mCurrentValue = mTargetValue - (mTargetValue - mCurrentValue) * (SampleType) std::pow(1.0 - mCoefficient, numSamples);
+
+        if (isCloseEnough()) {
+            setCurrentAndTargetValue(mTargetValue);
+        }
+    }
+
+    /** Advances one sample. For loops that don't need a whole block of values. */
+    SampleType getNextValue() noexcept {
+        if (mCountdown <= 0) {
+            return mCurrentValue;
+        }
+
+        if (mRamp == Ramp::linear) {
+            mCurrentValue += mStep;
+            mCountdown--;
+        } else {
+            mCurrentValue += mCoefficient * (mTargetValue - mCurrentValue);
+
+            // One-pole smoothing never quite arrives, so the countdown isn't used to end it.
+            // Instead it stops once the difference is negligible.
+            if (isCloseEnough()) {
+                mCountdown = 0;
+            }
+        }
+
+        if (mCountdown == 0) {
+            mCurrentValue = mTargetValue;
+        }
+
+        return mCurrentValue;
+    }
+
+private:
+
+    bool isCloseEnough() const noexcept {
+        const SampleType tolerance = mTolerance > 0 ? mTolerance : (SampleType) 1.0e-6 * (1 + std::abs(mTargetValue));
+        return std::abs(mTargetValue - mCurrentValue) <= tolerance;
+    }
+
+    double mSmoothingTimeMs;
+    Ramp mRamp;
+    SampleType mTolerance;
+
+    SampleType mCurrentValue = 0;
+    SampleType mTargetValue = 0;
+    SampleType mStep = 0;
+    SampleType mCoefficient = 1;
+
+    int mStepsToTarget = 1;
+    int mCountdown = 0;
+
+    ArenaVector<SampleType> mRampValues;
+
+};
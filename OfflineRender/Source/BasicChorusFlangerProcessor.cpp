@@ -0,0 +1,18 @@
+// Compiles BasicChorusFlanger's processor straight into the renderer. The plugin sources find
+// JuceHeader.h on the include path, so they're built against OfflineRender's modules and
+// options rather than the plugin's own, and the few JucePlugin_ settings they read from
+// the plugin's AppConfig.h are given here instead.
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#define JucePlugin_Name                 "BasicChorusFlanger"
+#define JucePlugin_IsSynth              0
+#define JucePlugin_WantsMidiInput       0
+#define JucePlugin_ProducesMidiOutput   0
+#define JucePlugin_IsMidiEffect         0
+
+// Every plugin defines its own createPluginFilter(), so it's renamed here to let all
+// three link into one binary.
+#define createPluginFilter createBasicChorusFlangerProcessor
+
+#include "../../BasicChorusFlanger/Source/PluginProcessor.cpp"
+#include "../../BasicChorusFlanger/Source/PluginEditor.cpp"
@@ -0,0 +1,32 @@
+// Compiles BasicDelay's processor straight into the renderer. The plugin sources find
+// JuceHeader.h on the include path, so they're built against OfflineRender's modules and
+// options rather than the plugin's own, and the few JucePlugin_ settings they read from
+// the plugin's AppConfig.h are given here instead.
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#define JucePlugin_Name                 "BasicDelay"
+#define JucePlugin_IsSynth              0
+#define JucePlugin_WantsMidiInput       0
+#define JucePlugin_ProducesMidiOutput   0
+#define JucePlugin_IsMidiEffect         0
+
+// Every plugin defines its own createPluginFilter(), so it's renamed here to let all
+// three link into one binary.
+#define createPluginFilter createBasicDelayProcessor
+
+#include "../../BasicDelay/Source/PluginProcessor.cpp"
+#include "../../BasicDelay/Source/PluginEditor.cpp"
+
+// The same processor with its delay lines interleaved, for comparing the two layouts
+AudioProcessor* JUCE_CALLTYPE createBasicDelayInterleavedProcessor() {
+    auto* processor = new BasicDelayAudioProcessor();
+    processor->setDelayStorage(BasicDelayAudioProcessor::DelayStorage::interleaved);
+    return processor;
+}
+
+// And with its delay lines dithered down to 16 bits
+AudioProcessor* JUCE_CALLTYPE createBasicDelayCompactProcessor() {
+    auto* processor = new BasicDelayAudioProcessor();
+    processor->setDelayStorage(BasicDelayAudioProcessor::DelayStorage::compact);
+    return processor;
+}
@@ -0,0 +1,193 @@
+#include "Benchmark.h"
+#include "OfflineRenderer.h"
+#include "PluginFactory.h"
+#include "../../Common/SIMD.h"
+
+//==============================================================================
+std::vector<BenchmarkCase> createBenchmarkCases() {
+    auto set = [] (const String& paramID, float value) {
+        return [paramID, value] (AudioProcessor& p) { OfflineRenderer::setParameter(p, paramID, value); };
+    };
+
+    auto setAll = [] (std::vector<std::pair<String, float>> values) {
+        return [values] (AudioProcessor& p) {
+            for (auto& v : values) {
+                OfflineRenderer::setParameter(p, v.first, v.second);
+            }
+        };
+    };
+
+    return {
+        { "gain",   "static",            set("gain", 0.5f), nullptr },
+        { "gain",   "automated",         set("gain", 0.5f),
+          [] (AudioProcessor& p, double t) { OfflineRenderer::setParameter(p, "gain", 0.5f + 0.4f * std::sin(MathConstants<float>::twoPi * (float) t)); } },
+
+        { "delay",  "static time",       setAll({ { "delaytime", 0.5f }, { "feedback", 0.5f } }), nullptr },
+        { "delay",  "feedback 0.98",     setAll({ { "delaytime", 0.5f }, { "feedback", 0.98f } }), nullptr },
+        { "delay",  "filtered feedback", setAll({ { "delaytime", 0.5f }, { "feedback", 0.7f }, { "lowcut", 200.0f }, { "highcut", 4000.0f } }), nullptr },
+        { "delay",  "ping-pong",         setAll({ { "delaytime", 0.375f }, { "feedback", 0.7f }, { "tap1cross", 1.0f } }), nullptr },
+        { "delay",  "16 taps",           setAll({ { "taps", 16.0f }, { "feedback", 0.5f }, { "tap1feedback", 0.5f }, { "tap2feedback", 0.5f } }), nullptr },
+        { "delay",  "automated time",    setAll({ { "delaytime", 0.5f }, { "feedback", 0.5f } }),
+          [] (AudioProcessor& p, double t) { OfflineRenderer::setParameter(p, "delaytime", 1.05f + 0.95f * std::sin(MathConstants<float>::pi * (float) t)); } },
+
+        // Planar against interleaved and 16-bit delay lines, at the default maximum delay, where every tap misses the cache
+        { "delay",              "long time",        setAll({ { "delaytime", 2.0f }, { "feedback", 0.5f } }), nullptr },
+        { "delay-interleaved",  "long time",        setAll({ { "delaytime", 2.0f }, { "feedback", 0.5f } }), nullptr },
+        { "delay-compact",      "long time",        setAll({ { "delaytime", 2.0f }, { "feedback", 0.5f } }), nullptr },
+        { "delay",              "long automated",   setAll({ { "delaytime", 2.0f }, { "feedback", 0.5f } }),
+          [] (AudioProcessor& p, double t) { OfflineRenderer::setParameter(p, "delaytime", 1.6f + 0.4f * std::sin(MathConstants<float>::pi * (float) t)); } },
+        { "delay-interleaved",  "long automated",   setAll({ { "delaytime", 2.0f }, { "feedback", 0.5f } }),
+          [] (AudioProcessor& p, double t) { OfflineRenderer::setParameter(p, "delaytime", 1.6f + 0.4f * std::sin(MathConstants<float>::pi * (float) t)); } },
+        { "delay-compact",      "long automated",   setAll({ { "delaytime", 2.0f }, { "feedback", 0.5f } }),
+          [] (AudioProcessor& p, double t) { OfflineRenderer::setParameter(p, "delaytime", 1.6f + 0.4f * std::sin(MathConstants<float>::pi * (float) t)); } },
+
+        // Paged delay lines a minute long, which page in on the audio thread since the renderer runs offline.
+        // The longest time range makes 0.3 on the delay time 45 seconds.
+        { "delay",              "minute delay",     setAll({ { "maxdelay", 60.0f }, { "timerange", 2.0f }, { "delaytime", 0.3f }, { "feedback", 0.5f } }), nullptr },
+        { "delay-compact",      "minute delay",     setAll({ { "maxdelay", 60.0f }, { "timerange", 2.0f }, { "delaytime", 0.3f }, { "feedback", 0.5f } }), nullptr },
+
+        { "chorus", "chorus",            setAll({ { "type", 0.0f }, { "feedback", 0.5f } }), nullptr },
+        { "chorus", "flanger",           setAll({ { "type", 1.0f }, { "feedback", 0.5f } }), nullptr },
+        { "chorus", "flanger fb 0.98",   setAll({ { "type", 1.0f }, { "feedback", 0.98f } }), nullptr },
+
+        // The renderer runs offline, so these oversample even with the default of offline-only oversampling
+        { "chorus", "flanger 2x",        setAll({ { "type", 1.0f }, { "feedback", 0.5f }, { "oversampling", 1.0f } }), nullptr },
+        { "chorus", "flanger 4x",        setAll({ { "type", 1.0f }, { "feedback", 0.5f }, { "oversampling", 2.0f } }), nullptr },
+        { "chorus", "8 voices",          setAll({ { "type", 0.0f }, { "feedback", 0.5f }, { "voices", 8.0f } }), nullptr },
+
+        // A track that's gone quiet. The warm-up run lets the tails die away, so these time the skipped blocks.
+        { "delay",  "silent input",      setAll({ { "delaytime", 0.5f }, { "feedback", 0.5f } }), nullptr, true },
+        { "chorus", "silent input",      setAll({ { "type", 0.0f }, { "feedback", 0.5f } }), nullptr, true },
+    };
+}
+
+namespace {
+
+    //==============================================================================
+    /** Returns the median time in seconds to process numSamples of input, after one untimed warm-up pass.
+        numInstances copies of the processor take a block each in turn, the way a host runs a session
+        full of them, so their state competes for the cache. Double runs the processors in double precision.
+     */
+    template <typename SampleType>
+    double timeProcessing (const BenchmarkCase& benchmarkCase, double sampleRate, int blockSize,
+                           const AudioBuffer<float>& input, int numRepeats, int numInstances, const ArgumentList& args) {
+        const auto precision = std::is_same<SampleType, double>::value ? AudioProcessor::doublePrecision
+                                                                       : AudioProcessor::singlePrecision;
+
+        std::vector<std::unique_ptr<AudioProcessor>> processors;
+        OwnedArray<OfflineRenderer> renderers;
+        OwnedArray<AudioBuffer<SampleType>> buffers;
+
+        for (int instance = 0; instance < numInstances; instance++) {
+            processors.push_back(createProcessor(benchmarkCase.plugin));
+            OfflineRenderer::applyChannelsOption(*processors.back(), args);
+            benchmarkCase.setup(*processors.back());
+
+            renderers.add(new OfflineRenderer(*processors.back(), sampleRate, blockSize, precision));
+            buffers.add(new AudioBuffer<SampleType>(renderers.getLast()->getNumChannels(), input.getNumSamples()));
+        }
+
+        auto runOnce = [&] {
+            for (auto* buffer : buffers) {
+                for (int channel = 0; channel < buffer->getNumChannels(); channel++) {
+                    const float* source = input.getReadPointer(channel % input.getNumChannels());
+                    std::copy(source, source + input.getNumSamples(), buffer->getWritePointer(channel));
+                }
+
+                if (benchmarkCase.silentInput) {
+                    buffer->clear();
+                }
+            }
+
+            auto startTicks = Time::getHighResolutionTicks();
+
+            for (int position = 0; position < input.getNumSamples(); position += blockSize) {
+                auto numSamples = jmin(blockSize, input.getNumSamples() - position);
+
+                for (int instance = 0; instance < numInstances; instance++) {
+                    if (benchmarkCase.automate != nullptr) {
+                        benchmarkCase.automate(*processors[(size_t) instance], position / sampleRate);
+                    }
+
+                    renderers[instance]->process(*buffers[instance], position, numSamples);
+                }
+            }
+
+            return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+        };
+
+        runOnce();
+
+        std::vector<double> timings;
+
+        for (int i = 0; i < numRepeats; i++) {
+            timings.push_back(runOnce());
+        }
+
+        std::sort(timings.begin(), timings.end());
+        return timings[timings.size() / 2];
+    }
+}
+
+//==============================================================================
+void runBenchmark (const ArgumentList& args) {
+    auto pluginFilter = args.getValueForOption("--plugin");
+    auto blockSizes = OfflineRenderer::getIntListForOption(args, "--blocksizes", "1,16,64,256,1024,8192");
+    auto sampleRates = OfflineRenderer::getIntListForOption(args, "--samplerates", "44100,48000,96000,192000,384000");
+    auto seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 1.0;
+    auto numRepeats = args.containsOption("--repeats") ? jmax(1, args.getValueForOption("--repeats").getIntValue()) : 5;
+    auto numInstances = args.containsOption("--instances") ? jmax(1, args.getValueForOption("--instances").getIntValue()) : 1;
+    auto useDouble = args.containsOption("--double");
+    auto csv = args.containsOption("--csv");
+
+    if (csv) {
+        std::cout << "plugin,regime,samplerate,blocksize,ns_per_sample,samples_per_second,realtime_factor" << std::endl;
+    } else {
+        std::cout << "DSP running with " << getSIMDLevelName(getSIMDLevel()) << (useDouble ? ", in double precision" : "")
+                  << std::endl << std::endl;
+        std::cout << String("plugin").paddedRight(' ', 19) << String("regime").paddedRight(' ', 18)
+                  << String("rate").paddedLeft(' ', 8) << String("block").paddedLeft(' ', 7)
+                  << String("ns/sample").paddedLeft(' ', 12) << String("samples/s").paddedLeft(' ', 14)
+                  << String("x realtime").paddedLeft(' ', 12) << std::endl;
+    }
+
+    for (auto& benchmarkCase : createBenchmarkCases()) {
+        if (pluginFilter.isNotEmpty() && ! pluginFilter.equalsIgnoreCase(benchmarkCase.plugin)) {
+            continue;
+        }
+
+        for (auto sampleRate : sampleRates) {
+            // The same noise is used for every run, so results are repeatable
+            auto numSamples = jmax(1, (int) (seconds * sampleRate));
+            AudioBuffer<float> input(2, numSamples);
+            Random random(0x5eed);
+
+            for (int channel = 0; channel < input.getNumChannels(); channel++) {
+                for (int i = 0; i < numSamples; i++) {
+                    input.setSample(channel, i, random.nextFloat() * 0.5f - 0.25f);
+                }
+            }
+
+            for (auto blockSize : blockSizes) {
+                // Time per instance, so the figures compare across --instances
+                auto elapsed = (useDouble ? timeProcessing<double>(benchmarkCase, sampleRate, blockSize, input, numRepeats, numInstances, args)
+                                          : timeProcessing<float>(benchmarkCase, sampleRate, blockSize, input, numRepeats, numInstances, args)) / numInstances;
+
+                // Each "sample" here is one sample frame, i.e. all channels at one point in time
+                auto nsPerSample = elapsed * 1.0e9 / numSamples;
+                auto samplesPerSecond = numSamples / jmax(elapsed, 1.0e-12);
+                auto realtimeFactor = samplesPerSecond / sampleRate;
+
+                if (csv) {
+                    std::cout << benchmarkCase.plugin << "," << benchmarkCase.regime << "," << sampleRate << ","
+                              << blockSize << "," << nsPerSample << "," << samplesPerSecond << "," << realtimeFactor << std::endl;
+                } else {
+                    std::cout << benchmarkCase.plugin.paddedRight(' ', 19) << benchmarkCase.regime.paddedRight(' ', 18)
+                              << String(sampleRate).paddedLeft(' ', 8) << String(blockSize).paddedLeft(' ', 7)
+                              << String(nsPerSample, 2).paddedLeft(' ', 12) << String(samplesPerSecond, 0).paddedLeft(' ', 14)
+                              << String(realtimeFactor, 1).paddedLeft(' ', 12) << std::endl;
+                }
+            }
+        }
+    }
+}
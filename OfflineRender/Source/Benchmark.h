@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** One parameter regime for one plugin. setup() runs once before processing, and
+    automate() (if set) runs before every block, the way host automation would. With
+    silentInput, the processors get silence instead of noise.
+ */
+struct BenchmarkCase {
+    String plugin;
+    String regime;
+    std::function<void (AudioProcessor&)> setup;
+    std::function<void (AudioProcessor&, double timeInSeconds)> automate;
+    bool silentInput = false;
+};
+
+/** The regimes --benchmark covers, which --rt-check reuses. */
+std::vector<BenchmarkCase> createBenchmarkCases();
+
+//==============================================================================
+/**
+    Measures the per-sample cost of each processor's processBlock() across block
+    sizes, sample rates and parameter regimes, and prints ns/sample and
+    samples/second for every combination.
+ */
+void runBenchmark (const ArgumentList& args);
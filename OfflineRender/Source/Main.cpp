@@ -0,0 +1,203 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Benchmark.h"
+#include "OfflineRenderer.h"
+#include "PluginFactory.h"
+#include "RealtimeCheck.h"
+#include "Regression.h"
+#include "../../Common/Arena.h"
+#include "../../Common/SIMD.h"
+
+//==============================================================================
+static std::unique_ptr<AudioProcessor> createProcessorForOption (const ArgumentList& args) {
+    args.failIfOptionIsMissing("--plugin");
+
+    auto name = args.getValueForOption("--plugin");
+    auto processor = createProcessor(name);
+
+    if (processor == nullptr) {
+        ConsoleApplication::fail("Unknown plugin '" + name + "', expected one of: "
+                                 + getProcessorNames().joinIntoString(", "));
+    }
+
+    return processor;
+}
+
+static void renderFile (const ArgumentList& args) {
+    auto inputFile = args.getExistingFileForOption("--input");
+    auto outputFile = args.getFileForOption("--output");
+
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(inputFile));
+
+    if (reader == nullptr) {
+        ConsoleApplication::fail("Couldn't read " + inputFile.getFullPathName());
+    }
+
+    // Sample rate and block size default to the file's rate and a typical host block
+    auto sampleRate = args.containsOption("--samplerate") ? args.getValueForOption("--samplerate").getDoubleValue()
+                                                          : reader->sampleRate;
+    auto blockSize = args.containsOption("--blocksize") ? args.getValueForOption("--blocksize").getIntValue() : 512;
+    auto bitsPerSample = args.containsOption("--bits") ? args.getValueForOption("--bits").getIntValue() : 32;
+
+    if (sampleRate <= 0 || blockSize <= 0) {
+        ConsoleApplication::fail("--samplerate and --blocksize must be positive");
+    }
+
+    auto processor = createProcessorForOption(args);
+    OfflineRenderer::applyChannelsOption(*processor, args);
+    OfflineRenderer::applyParameterOptions(*processor, args);
+
+    OfflineRenderer renderer(*processor, sampleRate, blockSize);
+    auto numChannels = renderer.getNumChannels();
+
+    // Render the tail too, so delays and choruses aren't cut off at the end of the file
+    auto tailSeconds = args.containsOption("--tail") ? args.getValueForOption("--tail").getDoubleValue()
+                                                     : processor->getTailLengthSeconds();
+
+    auto inputLength = (int64) std::ceil(reader->lengthInSamples * sampleRate / reader->sampleRate);
+    auto totalLength = inputLength + (int64) (tailSeconds * sampleRate);
+
+    // Oversampling delays the output, so render that much further and drop it from the start,
+    // the same as a host's delay compensation. The file then lines up with the input.
+    auto latency = (int64) processor->getLatencySamples();
+
+    // Read through a resampler only when the requested rate differs from the file's.
+    // Mono files are duplicated across both channels by the reader.
+    auto fileRate = reader->sampleRate;
+    std::unique_ptr<AudioSource> source(new AudioFormatReaderSource(reader.release(), true));
+
+    if (sampleRate != fileRate) {
+        auto* resampler = new ResamplingAudioSource(source.release(), true, numChannels);
+        resampler->setResamplingRatio(fileRate / sampleRate);
+        source.reset(resampler);
+    }
+
+    source->prepareToPlay(blockSize, sampleRate);
+
+    outputFile.deleteFile();
+    std::unique_ptr<FileOutputStream> outputStream(outputFile.createOutputStream());
+
+    if (outputStream == nullptr || outputStream->failedToOpen()) {
+        ConsoleApplication::fail("Couldn't write " + outputFile.getFullPathName());
+    }
+
+    WavAudioFormat wavFormat;
+    std::unique_ptr<AudioFormatWriter> writer(wavFormat.createWriterFor(outputStream.get(), sampleRate,
+                                                                        (unsigned int) processor->getTotalNumOutputChannels(),
+                                                                        bitsPerSample, {}, 0));
+
+    if (writer == nullptr) {
+        ConsoleApplication::fail("Can't write a " + String(bitsPerSample) + "-bit WAV at " + String(sampleRate) + " Hz");
+    }
+
+    // The writer owns the stream now
+    outputStream.release();
+
+    AudioBuffer<float> buffer(numChannels, blockSize);
+    auto startTime = Time::getMillisecondCounterHiRes();
+
+    for (int64 position = 0; position < totalLength + latency; position += blockSize) {
+        auto numSamples = (int) jmin((int64) blockSize, totalLength + latency - position);
+        auto numToSkip = (int) jlimit((int64) 0, (int64) numSamples, latency - position);
+
+        source->getNextAudioBlock(AudioSourceChannelInfo(&buffer, 0, numSamples));
+        renderer.process(buffer, 0, numSamples);
+        writer->writeFromAudioSampleBuffer(buffer, numToSkip, numSamples - numToSkip);
+    }
+
+    auto elapsedSeconds = (Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    auto renderedSeconds = totalLength / sampleRate;
+
+    std::cout << "Rendered " << renderedSeconds << " s of audio in " << elapsedSeconds << " s ("
+              << renderedSeconds / jmax(elapsedSeconds, 1.0e-9) << "x real time)" << std::endl;
+
+    source->releaseResources();
+}
+
+/** --simd caps the instruction set the DSP is dispatched to, so the levels can be checked against each other. */
+static bool applySIMDOption (const ArgumentList& args) {
+    if (! args.containsOption("--simd")) {
+        return true;
+    }
+
+    auto name = args.getValueForOption("--simd");
+
+    for (auto level : { SIMDLevel::baseline, SIMDLevel::avx2, SIMDLevel::avx512 }) {
+        if (name.equalsIgnoreCase(getSIMDLevelName(level))) {
+            setMaxSIMDLevel(level);
+            return true;
+        }
+    }
+
+    std::cerr << "Unknown --simd level '" << name << "', expected " << getSIMDLevelName(SIMDLevel::baseline)
+              << ", avx2 or avx512" << std::endl;
+    return false;
+}
+
+//==============================================================================
+int main (int argc, char* argv[]) {
+    if (! applySIMDOption(ArgumentList(argc, argv))) {
+        return 1;
+    }
+
+    // --hugepages backs the processors' arenas with transparent huge pages, where Linux has them
+    Arena::setUseHugePages(ArgumentList(argc, argv).containsOption("--hugepages"));
+
+    ConsoleApplication app;
+
+    app.addHelpCommand("--help|-h", "Renders audio files through the BasicGain, BasicDelay and "
+                                    "BasicChorusFlanger processors without a display or audio device.\n"
+                                    "Any command takes --simd=<sse2|avx2|avx512> to cap the instruction set the DSP "
+                                    "runs with, which is picked from the CPU by default, and --hugepages to put each\n"
+                                    "processor's state in transparent huge pages on Linux.", true);
+
+    app.addCommand({ "--render",
+                     "--render --plugin=<" + getProcessorNames().joinIntoString("|") + "> --input=<in.wav> --output=<out.wav> "
+                     "[--samplerate=<Hz>] [--blocksize=<samples>] [--channels=<n>] [--bits=<16|24|32>] [--tail=<seconds>] [--<paramID>=<value>...]",
+                     "Processes a file through one of the plugins and writes the result as a WAV file.",
+                     "Parameters are set by ID in their own units, e.g. --delaytime=0.75 --feedback=0.9 or --type=1.\n"
+                     "The file is resampled if --samplerate differs from its own rate. --channels runs the plugin with that\n"
+                     "many channels rather than stereo, where it supports them, and leaves any the file doesn't have silent.",
+                     renderFile });
+
+    app.addCommand({ "--benchmark",
+                     "--benchmark [--plugin=<name>] [--blocksizes=1,64,...] [--samplerates=44100,...] [--seconds=<s>] [--repeats=<n>] [--instances=<n>] [--channels=<n>] [--double] [--csv]",
+                     "Times every processor's processBlock() and prints ns/sample and samples/second.",
+                     "Covers block sizes 1 to 8192 and sample rates 44.1k to 384k by default, with chorus vs flanger,\n"
+                     "feedback at 0.98 and static vs automated delay time. Each figure is the median of --repeats runs\n"
+                     "over --seconds of seeded noise, after one warm-up run.\n"
+                     "--instances runs that many copies a block each in turn, like a busy session, and reports the time\n"
+                     "per instance. --plugin=delay-interleaved times the delay with interleaved delay lines,\n"
+                     "and --plugin=delay-compact with 16-bit ones.\n"
+                     "--channels runs them with that many channels rather than stereo, e.g. --plugin=delay --channels=16.\n"
+                     "--double runs the processors in double precision, as a host with a 64-bit engine does.",
+                     runBenchmark });
+
+    app.addCommand({ "--rt-check",
+                     "--rt-check [--plugin=<name>] [--blocksizes=1,64,...] [--samplerates=44100,...] [--seconds=<s>]",
+                     "Fails if any processBlock() allocates, frees or locks a mutex (Linux only).",
+                     "Every benchmark regime is run on one instance per plugin, re-prepared for each sample rate and\n"
+                     "block size, and processing as a live host would rather than offline. Offending calls are printed\n"
+                     "with a stack trace.",
+                     runRealtimeCheck });
+
+    app.addCommand({ "--regression",
+                     "--regression [--references=<folder>] [--plugin=<name>] [--update] [--exact | --max-abs-db=<dB> --rms-db=<dB>]",
+                     "Compares every processor's output for fixed stimuli and automation against reference WAV files.",
+                     "Renders impulses, a sine sweep and noise, each followed by silence, at 48 kHz in 512-sample blocks.\n"
+                     "The references are read from OfflineRender/References in the repo unless --references names another folder.\n"
+                     "--update writes the references. Without --exact, outputs pass if the max abs error and RMS error\n"
+                     "are at or below the given levels (defaults -100 dB and -120 dB).\n"
+                     "Every case is also run with each instruction set below the one in use, capped by --simd, and has to\n"
+                     "match its own output within the same limits. The delay's cases are run with interleaved delay lines too,\n"
+                     "which have to match exactly, and with 16-bit delay lines, which have to be within -54 dB max abs and\n"
+                     "-73 dB RMS. Every case is run in double precision too, which has to come close.\n"
+                     "The delay's and chorus's cases are run again from a fresh instance given the first one's state,\n"
+                     "which has to match exactly. Random tap tables are checked against a model of the delay,\n"
+                     "in 512 and 65536-sample blocks.",
+                     runRegression });
+
+    return app.findAndRunCommand(argc, argv);
+}
@@ -0,0 +1,119 @@
+#include "OfflineRenderer.h"
+
+//==============================================================================
+OfflineRenderer::OfflineRenderer (AudioProcessor& processor, double sampleRate, int blockSize,
+                                  AudioProcessor::ProcessingPrecision precision)
+    : mProcessor (processor), mSampleRate (sampleRate), mBlockSize (blockSize) {
+    // The precision has to be set before prepareToPlay(), like a host does
+    if (precision == AudioProcessor::doublePrecision && mProcessor.supportsDoublePrecisionProcessing()) {
+        mProcessor.setProcessingPrecision(AudioProcessor::doublePrecision);
+    }
+
+    // The processors ask getSampleRate() while processing, so the rate has to be
+    // set on the processor itself and not just passed to prepareToPlay().
+    mProcessor.setNonRealtime(true);
+    mProcessor.setRateAndBufferSizeDetails(mSampleRate, mBlockSize);
+    mProcessor.prepareToPlay(mSampleRate, mBlockSize);
+}
+
+OfflineRenderer::~OfflineRenderer() {
+    mProcessor.releaseResources();
+}
+
+//==============================================================================
+void OfflineRenderer::applyParameterOptions (AudioProcessor& processor, const ArgumentList& args) {
+    for (auto* parameter : processor.getParameters()) {
+        if (auto* ranged = dynamic_cast<RangedAudioParameter*>(parameter)) {
+            auto option = "--" + ranged->paramID;
+
+            if (args.containsOption(option)) {
+                auto value = args.getValueForOption(option).getFloatValue();
+                ranged->setValueNotifyingHost(ranged->convertTo0to1(value));
+            }
+        }
+    }
+}
+
+bool OfflineRenderer::setParameter (AudioProcessor& processor, const String& paramID, float value) {
+    for (auto* parameter : processor.getParameters()) {
+        if (auto* ranged = dynamic_cast<RangedAudioParameter*>(parameter)) {
+            if (ranged->paramID == paramID) {
+                ranged->setValueNotifyingHost(ranged->convertTo0to1(value));
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+float OfflineRenderer::getParameter (AudioProcessor& processor, const String& paramID) {
+    for (auto* parameter : processor.getParameters()) {
+        if (auto* ranged = dynamic_cast<RangedAudioParameter*>(parameter)) {
+            if (ranged->paramID == paramID) {
+                // A float parameter's own value, which a trip through 0 to 1 could move by an ulp
+                if (auto* floatParameter = dynamic_cast<AudioParameterFloat*>(ranged)) {
+                    return floatParameter->get();
+                }
+
+                return ranged->convertFrom0to1(ranged->getValue());
+            }
+        }
+    }
+
+    return 0;
+}
+
+bool OfflineRenderer::setNumChannels (AudioProcessor& processor, int numChannels) {
+    // Mono, stereo and the usual surround layouts where there is one, discrete channels otherwise
+    AudioProcessor::BusesLayout layout;
+    layout.inputBuses.add(AudioChannelSet::canonicalChannelSet(numChannels));
+    layout.outputBuses.add(AudioChannelSet::canonicalChannelSet(numChannels));
+
+    return numChannels > 0 && processor.setBusesLayout(layout);
+}
+
+void OfflineRenderer::applyChannelsOption (AudioProcessor& processor, const ArgumentList& args) {
+    if (args.containsOption("--channels")) {
+        auto numChannels = args.getValueForOption("--channels").getIntValue();
+
+        if (! setNumChannels(processor, numChannels)) {
+            ConsoleApplication::fail(processor.getName() + " doesn't support " + String(numChannels) + " channels");
+        }
+    }
+}
+
+Array<int> OfflineRenderer::getIntListForOption (const ArgumentList& args, const String& option, const String& defaultValue) {
+    auto text = args.containsOption(option) ? args.getValueForOption(option) : defaultValue;
+    Array<int> values;
+
+    for (auto& token : StringArray::fromTokens(text, ",", "")) {
+        values.add(token.trim().getIntValue());
+    }
+
+    return values;
+}
+
+int OfflineRenderer::getNumChannels() const noexcept {
+    return jmax(mProcessor.getTotalNumInputChannels(), mProcessor.getTotalNumOutputChannels());
+}
+
+template <typename SampleType>
+void OfflineRenderer::process (AudioBuffer<SampleType>& buffer, int startSample, int numSamples) {
+    jassert (buffer.getNumChannels() >= getNumChannels());
+    jassert (mProcessor.isUsingDoublePrecision() == std::is_same<SampleType, double>::value);
+
+    for (int position = 0; position < numSamples; position += mBlockSize) {
+        auto numThisBlock = jmin(mBlockSize, numSamples - position);
+
+        // Refers to the caller's memory, so nothing is copied or allocated per block.
+        AudioBuffer<SampleType> block(buffer.getArrayOfWritePointers(), getNumChannels(),
+                                 startSample + position, numThisBlock);
+
+        mMidiBuffer.clear();
+        mProcessor.processBlock(block, mMidiBuffer);
+    }
+}
+
+template void OfflineRenderer::process (AudioBuffer<float>&, int, int);
+template void OfflineRenderer::process (AudioBuffer<double>&, int, int);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+    Drives an AudioProcessor the same way a host would, but without an audio
+    device: prepareToPlay() at a fixed sample rate and block size, then
+    processBlock() as fast as the CPU allows.
+
+    Passing doublePrecision prepares the processor for 64-bit blocks, the way
+    a host with a 64-bit engine would, if the processor supports them.
+ */
+class OfflineRenderer {
+
+public:
+
+    OfflineRenderer (AudioProcessor& processor, double sampleRate, int blockSize,
+                     AudioProcessor::ProcessingPrecision precision = AudioProcessor::singlePrecision);
+    ~OfflineRenderer();
+
+    //==============================================================================
+    /** Sets every parameter whose ID is passed as a "--<paramID>=<value>" option.
+        Values are in the parameter's own range, e.g. --delaytime=0.75 or --type=1.
+     */
+    static void applyParameterOptions (AudioProcessor& processor, const ArgumentList& args);
+
+    /** Sets a parameter by ID, in the parameter's own range. Returns false if there's no such parameter. */
+    static bool setParameter (AudioProcessor& processor, const String& paramID, float value);
+
+    /** A parameter's value by ID, in the parameter's own range, or 0 if there's no such parameter. */
+    static float getParameter (AudioProcessor& processor, const String& paramID);
+
+    /** Gives the processor's main input and output numChannels channels each, before it's prepared.
+        Returns false if the processor doesn't support that many.
+     */
+    static bool setNumChannels (AudioProcessor& processor, int numChannels);
+
+    /** Applies a --channels=<n> option with setNumChannels(), and fails if the processor can't take it.
+        Without the option, the processor keeps its own layout.
+     */
+    static void applyChannelsOption (AudioProcessor& processor, const ArgumentList& args);
+
+    /** Parses a comma-separated option such as --blocksizes=64,512, or the default if it's absent. */
+    static Array<int> getIntListForOption (const ArgumentList& args, const String& option, const String& defaultValue);
+
+    //==============================================================================
+    int getNumChannels() const noexcept;
+    int getBlockSize() const noexcept         { return mBlockSize; }
+    double getSampleRate() const noexcept     { return mSampleRate; }
+
+    /** Processes numSamples of the buffer in place, handing it to the processor in
+        chunks of at most the block size. The buffer must have getNumChannels() channels.
+        Double buffers are only for processors prepared with doublePrecision.
+     */
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& buffer, int startSample, int numSamples);
+
+private:
+
+    AudioProcessor& mProcessor;
+
+    double mSampleRate;
+    int mBlockSize;
+
+    MidiBuffer mMidiBuffer;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE (OfflineRenderer)
+
+};
@@ -0,0 +1,39 @@
+#include "PluginFactory.h"
+
+// These are the plugins' createPluginFilter() functions, renamed by the wrappers
+// in BasicGainProcessor.cpp, BasicDelayProcessor.cpp and BasicChorusFlangerProcessor.cpp.
+AudioProcessor* JUCE_CALLTYPE createBasicGainProcessor();
+AudioProcessor* JUCE_CALLTYPE createBasicDelayProcessor();
+AudioProcessor* JUCE_CALLTYPE createBasicDelayInterleavedProcessor();
+AudioProcessor* JUCE_CALLTYPE createBasicDelayCompactProcessor();
+AudioProcessor* JUCE_CALLTYPE createBasicChorusFlangerProcessor();
+
+StringArray getProcessorNames() {
+    return { "gain", "delay", "chorus" };
+}
+
+std::unique_ptr<AudioProcessor> createProcessor (const String& name) {
+    if (name.equalsIgnoreCase("gain")) {
+        return std::unique_ptr<AudioProcessor>(createBasicGainProcessor());
+    }
+
+    if (name.equalsIgnoreCase("delay")) {
+        return std::unique_ptr<AudioProcessor>(createBasicDelayProcessor());
+    }
+
+    // Not listed in getProcessorNames(), since it gives the same output as "delay"
+    if (name.equalsIgnoreCase("delay-interleaved")) {
+        return std::unique_ptr<AudioProcessor>(createBasicDelayInterleavedProcessor());
+    }
+
+    // Not listed either, since its output is only close to "delay"'s
+    if (name.equalsIgnoreCase("delay-compact")) {
+        return std::unique_ptr<AudioProcessor>(createBasicDelayCompactProcessor());
+    }
+
+    if (name.equalsIgnoreCase("chorus") || name.equalsIgnoreCase("flanger")) {
+        return std::unique_ptr<AudioProcessor>(createBasicChorusFlangerProcessor());
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Short names accepted by createProcessor(), in the order they're listed in --help. */
+StringArray getProcessorNames();
+
+/** Creates one of the repo's processors by short name ("gain", "delay" or "chorus").
+    "flanger" is another name for the chorus, "delay-interleaved" is the delay with
+    its delay lines interleaved, and "delay-compact" is the delay with 16-bit delay
+    lines. Returns nullptr if the name isn't recognised.
+ */
+std::unique_ptr<AudioProcessor> createProcessor (const String& name);
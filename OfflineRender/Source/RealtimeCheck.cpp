@@ -0,0 +1,73 @@
+#include "RealtimeCheck.h"
+#include "Benchmark.h"
+#include "OfflineRenderer.h"
+#include "PluginFactory.h"
+#include "RealtimeGuard.h"
+
+//==============================================================================
+void runRealtimeCheck (const ArgumentList& args) {
+    if (! ScopedRealtimeGuard::isSupported()) {
+        ConsoleApplication::fail("--rt-check needs glibc to intercept malloc and pthread calls, so it only runs on Linux");
+    }
+
+    auto pluginFilter = args.getValueForOption("--plugin");
+    auto blockSizes = OfflineRenderer::getIntListForOption(args, "--blocksizes", "1,64,480,512,4096");
+    auto sampleRates = OfflineRenderer::getIntListForOption(args, "--samplerates", "44100,48000,96000,192000");
+    auto seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 0.5;
+
+    int totalViolations = 0;
+
+    for (auto& benchmarkCase : createBenchmarkCases()) {
+        if (pluginFilter.isNotEmpty() && ! pluginFilter.equalsIgnoreCase(benchmarkCase.plugin)) {
+            continue;
+        }
+
+        // One instance is re-prepared for every configuration, the way a host
+        // reuses a plugin when the session's rate or buffer size changes.
+        auto processor = createProcessor(benchmarkCase.plugin);
+        benchmarkCase.setup(*processor);
+
+        for (auto sampleRate : sampleRates) {
+            for (auto blockSize : blockSizes) {
+                OfflineRenderer renderer(*processor, sampleRate, blockSize);
+
+                // Checked the way a live host runs it, since offline a processor may do
+                // work on the audio thread that it otherwise leaves to another one
+                processor->setNonRealtime(false);
+
+                auto numSamples = jmax(blockSize, (int) (seconds * sampleRate));
+                AudioBuffer<float> buffer(renderer.getNumChannels(), numSamples);
+                Random random(0x5eed);
+
+                for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
+                    for (int i = 0; i < numSamples; i++) {
+                        buffer.setSample(channel, i, random.nextFloat() * 0.5f - 0.25f);
+                    }
+                }
+
+                ScopedRealtimeGuard::resetViolations();
+
+                for (int position = 0; position < numSamples; position += blockSize) {
+                    if (benchmarkCase.automate != nullptr) {
+                        benchmarkCase.automate(*processor, position / (double) sampleRate);
+                    }
+
+                    // Only processBlock() itself is checked. Automation and prepareToPlay() may allocate.
+                    ScopedRealtimeGuard guard;
+                    renderer.process(buffer, position, jmin(blockSize, numSamples - position));
+                }
+
+                auto numViolations = ScopedRealtimeGuard::getNumViolations();
+                totalViolations += numViolations;
+
+                std::cout << benchmarkCase.plugin.paddedRight(' ', 8) << benchmarkCase.regime.paddedRight(' ', 18)
+                          << String(sampleRate).paddedLeft(' ', 8) << String(blockSize).paddedLeft(' ', 7) << "  "
+                          << (numViolations == 0 ? String("ok") : String(numViolations) + " violations") << std::endl;
+            }
+        }
+    }
+
+    if (totalViolations > 0) {
+        ConsoleApplication::fail(String(totalViolations) + " real-time violations in processBlock(), see the stack traces above");
+    }
+}
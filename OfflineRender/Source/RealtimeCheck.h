@@ -0,0 +1,11 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+    Runs every processor through prepareToPlay() at several sample rates and block
+    sizes, and fails if processBlock() ever allocates, frees or locks a mutex.
+    See ScopedRealtimeGuard for how the calls are caught.
+ */
+void runRealtimeCheck (const ArgumentList& args);
@@ -0,0 +1,245 @@
+#include "RealtimeGuard.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#if defined (__linux__) && defined (__GLIBC__)
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// glibc's own allocator entry points, which the replacements below forward to
+extern "C" {
+    void* __libc_malloc (size_t size);
+    void* __libc_calloc (size_t count, size_t size);
+    void* __libc_realloc (void* ptr, size_t size);
+    void* __libc_memalign (size_t alignment, size_t size);
+    void __libc_free (void* ptr);
+}
+
+namespace {
+
+    // Per-thread, so only the thread that's pretending to be the audio thread is checked
+    thread_local int gGuardDepth = 0;
+    thread_local bool gIsReporting = false;
+
+    std::atomic<int> gNumViolations { 0 };
+
+    // Only the first few stack traces are printed, the rest are just counted
+    const int maxReportedViolations = 16;
+
+    void writeToStderr (const char* text) noexcept {
+        auto ignored = write(STDERR_FILENO, text, std::strlen(text));
+        (void) ignored;
+    }
+
+    void reportViolation (const char* functionName) noexcept {
+        if (gGuardDepth == 0 || gIsReporting) {
+            return;
+        }
+
+        // backtrace() can allocate the first time it's called, so don't report ourselves
+        gIsReporting = true;
+
+        if (++gNumViolations <= maxReportedViolations) {
+            writeToStderr("\n*** Real-time violation: ");
+            writeToStderr(functionName);
+            writeToStderr(" called on the audio thread\n");
+
+            void* frames[64];
+            auto numFrames = backtrace(frames, 64);
+            backtrace_symbols_fd(frames, numFrames, STDERR_FILENO);
+        }
+
+        gIsReporting = false;
+    }
+
+    using MutexFunction = int (*) (pthread_mutex_t*);
+
+    // Resolved lazily, without a function-local static whose guard could itself lock
+    std::atomic<MutexFunction> gRealMutexLock { nullptr };
+    std::atomic<MutexFunction> gRealMutexTryLock { nullptr };
+
+    MutexFunction getRealFunction (std::atomic<MutexFunction>& cached, const char* name) noexcept {
+        auto function = cached.load(std::memory_order_relaxed);
+
+        if (function == nullptr) {
+            function = (MutexFunction) dlsym(RTLD_NEXT, name);
+            cached.store(function, std::memory_order_relaxed);
+        }
+
+        return function;
+    }
+}
+
+//==============================================================================
+extern "C" {
+
+    void* malloc (size_t size) noexcept {
+        reportViolation("malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc (size_t count, size_t size) noexcept {
+        reportViolation("calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc (void* ptr, size_t size) noexcept {
+        reportViolation("realloc");
+        return __libc_realloc(ptr, size);
+    }
+
+    void* memalign (size_t alignment, size_t size) noexcept {
+        reportViolation("memalign");
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc (size_t alignment, size_t size) noexcept {
+        reportViolation("aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign (void** result, size_t alignment, size_t size) noexcept {
+        reportViolation("posix_memalign");
+
+        if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+            return EINVAL;
+        }
+
+        auto* ptr = __libc_memalign(alignment, size);
+
+        if (ptr == nullptr) {
+            return ENOMEM;
+        }
+
+        *result = ptr;
+        return 0;
+    }
+
+    void free (void* ptr) noexcept {
+        if (ptr != nullptr) {
+            reportViolation("free");
+        }
+
+        __libc_free(ptr);
+    }
+
+    int pthread_mutex_lock (pthread_mutex_t* mutex) noexcept {
+        reportViolation("pthread_mutex_lock");
+        return getRealFunction(gRealMutexLock, "pthread_mutex_lock")(mutex);
+    }
+
+    int pthread_mutex_trylock (pthread_mutex_t* mutex) noexcept {
+        reportViolation("pthread_mutex_trylock");
+        return getRealFunction(gRealMutexTryLock, "pthread_mutex_trylock")(mutex);
+    }
+}
+
+//==============================================================================
+// These go straight to glibc rather than through malloc(), so each call is reported once, by name
+static void* allocate (size_t size, const char* functionName) {
+    reportViolation(functionName);
+
+    if (auto* ptr = __libc_malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+static void deallocate (void* ptr, const char* functionName) noexcept {
+    if (ptr != nullptr) {
+        reportViolation(functionName);
+    }
+
+    __libc_free(ptr);
+}
+
+void* operator new (size_t size)                                  { return allocate(size, "operator new"); }
+void* operator new[] (size_t size)                                { return allocate(size, "operator new[]"); }
+void* operator new (size_t size, const std::nothrow_t&) noexcept {
+    reportViolation("operator new");
+    return __libc_malloc(size == 0 ? 1 : size);
+}
+void* operator new[] (size_t size, const std::nothrow_t&) noexcept {
+    reportViolation("operator new[]");
+    return __libc_malloc(size == 0 ? 1 : size);
+}
+
+void operator delete (void* ptr) noexcept                         { deallocate(ptr, "operator delete"); }
+void operator delete[] (void* ptr) noexcept                       { deallocate(ptr, "operator delete[]"); }
+void operator delete (void* ptr, size_t) noexcept                 { deallocate(ptr, "operator delete"); }
+void operator delete[] (void* ptr, size_t) noexcept               { deallocate(ptr, "operator delete[]"); }
+void operator delete (void* ptr, const std::nothrow_t&) noexcept  { deallocate(ptr, "operator delete"); }
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept { deallocate(ptr, "operator delete[]"); }
+
+// The over-aligned forms, which new uses for anything declared alignas() past 16 bytes.
+// They only exist with C++17 or -faligned-new, which the Linux build turns on for this.
+#if __cpp_aligned_new
+static void* allocateAligned (size_t size, std::align_val_t alignment, const char* functionName) {
+    reportViolation(functionName);
+
+    if (auto* ptr = __libc_memalign((size_t) alignment, size == 0 ? 1 : size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new (size_t size, std::align_val_t alignment)    { return allocateAligned(size, alignment, "operator new"); }
+void* operator new[] (size_t size, std::align_val_t alignment)  { return allocateAligned(size, alignment, "operator new[]"); }
+void* operator new (size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    reportViolation("operator new");
+    return __libc_memalign((size_t) alignment, size == 0 ? 1 : size);
+}
+void* operator new[] (size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    reportViolation("operator new[]");
+    return __libc_memalign((size_t) alignment, size == 0 ? 1 : size);
+}
+
+void operator delete (void* ptr, std::align_val_t) noexcept                         { deallocate(ptr, "operator delete"); }
+void operator delete[] (void* ptr, std::align_val_t) noexcept                       { deallocate(ptr, "operator delete[]"); }
+void operator delete (void* ptr, size_t, std::align_val_t) noexcept                 { deallocate(ptr, "operator delete"); }
+void operator delete[] (void* ptr, size_t, std::align_val_t) noexcept               { deallocate(ptr, "operator delete[]"); }
+void operator delete (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept  { deallocate(ptr, "operator delete"); }
+void operator delete[] (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(ptr, "operator delete[]"); }
+#endif
+
+//==============================================================================
+ScopedRealtimeGuard::ScopedRealtimeGuard() noexcept {
+    gGuardDepth++;
+}
+
+ScopedRealtimeGuard::~ScopedRealtimeGuard() noexcept {
+    gGuardDepth--;
+}
+
+bool ScopedRealtimeGuard::isSupported() noexcept {
+    return true;
+}
+
+int ScopedRealtimeGuard::getNumViolations() noexcept {
+    return gNumViolations.load();
+}
+
+void ScopedRealtimeGuard::resetViolations() noexcept {
+    gNumViolations = 0;
+}
+
+#else
+
+//==============================================================================
+ScopedRealtimeGuard::ScopedRealtimeGuard() noexcept {}
+ScopedRealtimeGuard::~ScopedRealtimeGuard() noexcept {}
+
+bool ScopedRealtimeGuard::isSupported() noexcept  { return false; }
+int ScopedRealtimeGuard::getNumViolations() noexcept  { return 0; }
+void ScopedRealtimeGuard::resetViolations() noexcept {}
+
+#endif
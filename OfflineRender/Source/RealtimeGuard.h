@@ -0,0 +1,34 @@
+#pragma once
+
+//==============================================================================
+/**
+    While a ScopedRealtimeGuard is alive, any malloc/calloc/realloc/free,
+    memalign/aligned_alloc/posix_memalign, operator new/delete (aligned or not)
+    or pthread_mutex_lock/trylock made on the same thread is reported to stderr
+    with a stack trace and counted as a violation.
+
+    This works by replacing those functions for the whole executable, so it only
+    does anything on Linux/glibc. Elsewhere isSupported() returns false and the
+    guard is a no-op.
+
+    Deliberately free of JUCE, since it sits underneath JUCE's own allocations.
+ */
+class ScopedRealtimeGuard {
+
+public:
+
+    ScopedRealtimeGuard() noexcept;
+    ~ScopedRealtimeGuard() noexcept;
+
+    static bool isSupported() noexcept;
+
+    /** Total number of violations seen on any thread since the last reset. */
+    static int getNumViolations() noexcept;
+    static void resetViolations() noexcept;
+
+private:
+
+    ScopedRealtimeGuard (const ScopedRealtimeGuard&) = delete;
+    ScopedRealtimeGuard& operator= (const ScopedRealtimeGuard&) = delete;
+
+};
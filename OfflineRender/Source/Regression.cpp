@@ -0,0 +1,712 @@
+#include "Regression.h"
+#include "OfflineRenderer.h"
+#include "PluginFactory.h"
+#include "../../Common/SIMD.h"
+
+namespace {
+
+    //==============================================================================
+    struct ParameterChange {
+        double timeInSeconds;
+        String paramID;
+        float value;
+    };
+
+    /** A plugin plus a parameter script. Changes at time 0 are the initial settings.
+        Cases that only need some of the stimuli list them, which keeps the references small.
+        numChannels is the processor's own layout, stereo for all of them, unless it's set.
+        Live cases are prepared the way a realtime host would, rather than for an offline render.
+        Restored cases save their initial settings and load them into a fresh instance, which renders.
+     */
+    struct RegressionCase {
+        String plugin;
+        String name;
+        std::vector<ParameterChange> automation;
+        StringArray stimuli = {};
+        int numChannels = 0;
+        AudioProcessor::ProcessingPrecision precision = AudioProcessor::singlePrecision;
+        bool live = false;
+        bool restoredFromState = false;
+    };
+
+    std::vector<RegressionCase> createRegressionCases() {
+        std::vector<RegressionCase> cases = {
+            { "gain",   "ramps",   { { 0.0, "gain", 0.5f }, { 0.5, "gain", 1.0f }, { 1.5, "gain", 0.1f } } },
+
+            { "delay",  "static",  { { 0.0, "delaytime", 0.3f }, { 0.0, "feedback", 0.6f }, { 0.0, "drywet", 0.5f } } },
+            { "delay",  "automated", { { 0.0, "delaytime", 0.3f }, { 0.0, "feedback", 0.5f }, { 0.0, "drywet", 0.5f },
+                                       { 0.5, "delaytime", 0.7f }, { 1.2, "delaytime", 0.15f },
+                                       { 1.5, "feedback", 0.98f }, { 2.0, "drywet", 1.0f } } },
+
+            // Without feedback the tail is long gone by 2.5s, and silent blocks are being skipped. Then the taps
+            // reach further back, where nothing but silence went in, so the output must stay silent.
+            { "delay",  "widened", { { 0.0, "delaytime", 0.3f }, { 0.0, "feedback", 0.0f }, { 0.0, "drywet", 1.0f },
+                                     { 2.5, "delaytime", 1.2f }, { 2.5, "taps", 2.0f } } },
+            { "delay",  "maxdelay", { { 0.0, "delaytime", 1.2f }, { 0.0, "maxdelay", 0.3f }, { 0.0, "feedback", 0.0f },
+                                      { 0.0, "drywet", 1.0f }, { 2.5, "maxdelay", 2.0f } } },
+
+            // The 1 - 20 second range, gliding from 1 to 1.2 seconds, then cut back to 0.9 by maxdelay
+            { "delay",  "timerange", { { 0.0, "timerange", 1.0f }, { 0.0, "delaytime", 0.1f }, { 0.0, "feedback", 0.5f },
+                                       { 0.0, "drywet", 0.5f }, { 1.0, "delaytime", 0.12f }, { 2.0, "maxdelay", 0.9f } } },
+
+            // The feedback loop's filters held still, then each brought in and taken back out to the open end
+            // of its range, where it's switched off, while the repeats are still going round
+            { "delay",  "filtered", { { 0.0, "delaytime", 0.25f }, { 0.0, "feedback", 0.8f }, { 0.0, "lowcut", 300.0f },
+                                      { 0.0, "highcut", 3000.0f } },
+              { "impulses" } },
+            { "delay",  "filtered-automated", { { 0.0, "delaytime", 0.25f }, { 0.0, "feedback", 0.8f }, { 0.5, "lowcut", 500.0f },
+                                                { 1.0, "highcut", 2000.0f }, { 1.8, "lowcut", 20.0f }, { 2.4, "highcut", 20000.0f } },
+              { "impulses" } },
+
+            { "chorus", "chorus",  { { 0.0, "type", 0.0f }, { 0.0, "rate", 1.5f }, { 0.0, "depth", 0.7f },
+                                     { 0.0, "feedback", 0.3f }, { 0.0, "phaseoffset", 0.25f } } },
+            { "chorus", "flanger", { { 0.0, "type", 1.0f }, { 0.0, "rate", 0.5f }, { 0.0, "depth", 1.0f },
+                                     { 0.0, "feedback", 0.9f }, { 0.0, "phaseoffset", 0.0f } } },
+            { "chorus", "automated", { { 0.0, "type", 0.0f }, { 0.0, "rate", 10.0f }, { 0.0, "depth", 0.5f },
+                                       { 0.7, "rate", 20.0f }, { 1.0, "type", 1.0f },
+                                       { 1.4, "depth", 0.1f }, { 1.8, "phaseoffset", 0.5f } } },
+
+            // The same for the voices, going from one flanger voice to the furthest back chorus
+            { "chorus", "widened", { { 0.0, "type", 1.0f }, { 0.0, "voices", 1.0f }, { 0.0, "feedback", 0.0f },
+                                     { 0.0, "drywet", 1.0f }, { 2.5, "type", 0.0f }, { 2.5, "voices", 8.0f } } },
+        };
+
+        // Every interpolation kernel, in the same order as the interpolation parameter, held still and then
+        // moving, where it's also switched to the next one while the delay lines still ring. Impulses show
+        // each kernel's own response at every echo. Delay times step by 10ms, a whole number of samples
+        // at 48 kHz, so the static delay is cut short by maxdelay instead, which has no step.
+        const char* kernelNames[] = { "linear", "hermite", "lagrange", "thiran", "sinc8", "sinc16" };
+
+        for (int kernel = 0; kernel < numElementsInArray(kernelNames); kernel++) {
+            const String name(kernelNames[kernel]);
+            const auto interpolation = (float) kernel;
+
+            cases.push_back({ "delay", name + "-static", { { 0.0, "interpolation", interpolation }, { 0.0, "delaytime", 0.3f },
+                                                           { 0.0, "maxdelay", 0.2503f }, { 0.0, "feedback", 0.6f } },
+                              { "impulses" } });
+            cases.push_back({ "delay", name + "-automated", { { 0.0, "interpolation", interpolation }, { 0.0, "delaytime", 0.3f },
+                                                              { 0.0, "feedback", 0.5f }, { 0.5, "delaytime", 0.55f },
+                                                              { 1.2, "delaytime", 0.2f }, { 2.0, "interpolation", (float) ((kernel + 1) % 6) } },
+                              { "impulses" } });
+
+            cases.push_back({ "chorus", name + "-flanger", { { 0.0, "interpolation", interpolation }, { 0.0, "type", 1.0f },
+                                                             { 0.0, "rate", 0.5f }, { 0.0, "depth", 1.0f }, { 0.0, "feedback", 0.9f } },
+                              { "impulses" } });
+            cases.push_back({ "chorus", name + "-automated", { { 0.0, "interpolation", interpolation }, { 0.0, "type", 0.0f },
+                                                               { 0.0, "rate", 10.0f }, { 0.0, "depth", 0.5f }, { 0.7, "rate", 20.0f },
+                                                               { 0.6, "interpolation", (float) ((kernel + 1) % 6) },
+                                                               { 1.0, "type", 1.0f }, { 1.4, "depth", 0.1f } },
+                              { "impulses" } });
+        }
+
+        // Every LFO shape, in the same order as the shape parameter, held still on all eight voices, each of
+        // which reads it at its own phase. Feedback carries every click round the delay lines for a while,
+        // which traces the sweep out between them, and the rate keeps the clicks from landing in step with it.
+        const char* shapeNames[] = { "sine", "triangle", "square", "sampleandhold", "smoothedrandom" };
+
+        for (int shape = 0; shape < numElementsInArray(shapeNames); shape++) {
+            cases.push_back({ "chorus", String(shapeNames[shape]) + "-8-voices",
+                              { { 0.0, "shape", (float) shape }, { 0.0, "type", 0.0f }, { 0.0, "voices", 8.0f },
+                                { 0.0, "rate", 1.3f }, { 0.0, "depth", 0.8f }, { 0.0, "feedback", 0.7f },
+                                { 0.0, "phaseoffset", 0.25f } },
+                              { "impulses" } });
+        }
+
+        // The tap table: five taps spread across the stereo field, moved while they ring. Then one tap crossing
+        // all of its feedback over, so the repeats go back and forth, and three feeding back 2.7 in all, which
+        // is scaled down to 1, and then less and less, so the scale has to ramp back up.
+        cases.push_back({ "delay", "taps-several", { { 0.0, "delaytime", 0.2f }, { 0.0, "feedback", 0.5f }, { 0.0, "taps", 5.0f },
+                                                     { 0.0, "tap1pan", -0.6f }, { 0.0, "tap1feedback", 0.5f },
+                                                     { 0.0, "tap2time", 0.33f }, { 0.0, "tap2gain", 0.8f }, { 0.0, "tap2pan", 0.6f },
+                                                     { 0.0, "tap2feedback", 0.2f }, { 0.0, "tap2cross", 0.5f },
+                                                     { 0.0, "tap3time", 0.47f }, { 0.0, "tap3gain", 0.6f }, { 0.0, "tap3pan", -0.2f },
+                                                     { 0.0, "tap4time", 0.61f }, { 0.0, "tap4gain", 0.5f }, { 0.0, "tap4pan", 1.0f },
+                                                     { 0.0, "tap5time", 0.9f }, { 0.0, "tap5gain", 0.3f }, { 0.0, "tap5pan", -1.0f },
+                                                     { 0.0, "tap5feedback", 0.2f },
+                                                     { 1.0, "tap3pan", 0.7f }, { 1.0, "tap4gain", 0.2f }, { 1.6, "tap2cross", 0.0f } },
+                          { "impulses" } });
+        cases.push_back({ "delay", "pingpong", { { 0.0, "delaytime", 0.3f }, { 0.0, "feedback", 0.7f }, { 0.0, "tap1cross", 1.0f } },
+                          { "impulses" } });
+        cases.push_back({ "delay", "taps-overfed", { { 0.0, "delaytime", 0.25f }, { 0.0, "feedback", 0.9f }, { 0.0, "taps", 3.0f },
+                                                     { 0.0, "tap2time", 0.4f }, { 0.0, "tap2pan", -0.5f }, { 0.0, "tap2feedback", 0.9f },
+                                                     { 0.0, "tap3time", 0.55f }, { 0.0, "tap3pan", 0.5f }, { 0.0, "tap3feedback", 0.8f },
+                                                     { 1.2, "tap2feedback", 0.0f }, { 2.0, "taps", 1.0f } },
+                          { "impulses" } });
+
+        // The delay from mono up to a 7.1.4 bed plus four, with a second tap panned and crossing over, which
+        // covers a channel on its own, pairs, and groups of four both whole and part filled
+        for (int numChannels : { 1, 3, 6, 16 }) {
+            cases.push_back({ "delay", "channels-" + String(numChannels),
+                              { { 0.0, "delaytime", 0.3f }, { 0.0, "feedback", 0.6f }, { 0.0, "taps", 2.0f },
+                                { 0.0, "tap2time", 0.45f }, { 0.0, "tap2pan", -0.5f }, { 0.0, "tap2cross", 0.3f },
+                                { 1.2, "tap2pan", 0.8f } },
+                              { "impulses" }, numChannels });
+        }
+
+        // The delay in double precision only comes close to its float output (see createVariants()),
+        // so it has references of its own, for a still and a moving delay time and a spread of kernels
+        cases.push_back({ "delay", "double-static", { { 0.0, "delaytime", 0.3f }, { 0.0, "feedback", 0.6f }, { 0.0, "drywet", 0.5f },
+                                                      { 0.0, "taps", 2.0f }, { 0.0, "tap2time", 0.45f }, { 0.0, "tap2pan", -0.5f } },
+                          { "impulses" }, 0, AudioProcessor::doublePrecision });
+        cases.push_back({ "delay", "double-automated", { { 0.0, "delaytime", 0.3f }, { 0.0, "feedback", 0.5f }, { 0.0, "drywet", 0.5f },
+                                                         { 0.5, "delaytime", 0.7f }, { 1.0, "interpolation", 5.0f },
+                                                         { 1.2, "delaytime", 0.15f }, { 1.5, "feedback", 0.98f },
+                                                         { 2.0, "interpolation", 3.0f } },
+                          { "impulses" }, 0, AudioProcessor::doublePrecision });
+
+        // The flanger at 2x and 4x, through one half-band filter and then two, where the sweep shows what's
+        // left of the aliasing. Renders drop the latency, so a wrong one puts every click in the wrong place.
+        // Without feedback and then widened to the chorus, silent blocks are skipped while oversampling too.
+        // Live, oversampling only runs if it isn't just for offline renders, so live-offline-only has to
+        // match chorus-flanger-impulses and live-2x oversampled-2x-impulses.
+        const std::vector<ParameterChange> flanger = { { 0.0, "type", 1.0f }, { 0.0, "rate", 0.5f }, { 0.0, "depth", 1.0f },
+                                                       { 0.0, "feedback", 0.9f }, { 0.0, "phaseoffset", 0.0f } };
+        auto withOversampling = [] (std::vector<ParameterChange> automation, float oversampling, float offlineOnly) {
+            automation.push_back({ 0.0, "oversampling", oversampling });
+            automation.push_back({ 0.0, "oversampleoffline", offlineOnly });
+            return automation;
+        };
+
+        cases.push_back({ "chorus", "oversampled-2x", withOversampling(flanger, 1.0f, 1.0f), { "impulses", "sweep" } });
+        cases.push_back({ "chorus", "oversampled-4x", withOversampling(flanger, 2.0f, 1.0f), { "impulses", "sweep" } });
+        cases.push_back({ "chorus", "oversampled-widened",
+                          withOversampling({ { 0.0, "type", 1.0f }, { 0.0, "voices", 1.0f }, { 0.0, "feedback", 0.0f },
+                                             { 0.0, "drywet", 1.0f }, { 2.5, "type", 0.0f }, { 2.5, "voices", 8.0f } }, 2.0f, 1.0f),
+                          { "impulses" } });
+        cases.push_back({ "chorus", "live-offline-only", withOversampling(flanger, 2.0f, 1.0f), { "impulses" },
+                          0, AudioProcessor::singlePrecision, true });
+        cases.push_back({ "chorus", "live-2x", withOversampling(flanger, 1.0f, 0.0f), { "impulses" },
+                          0, AudioProcessor::singlePrecision, true });
+
+        return cases;
+    }
+
+    //==============================================================================
+    /** Each stimulus is followed by this much silence, which covers the longest delay plus some feedback. */
+    const double silenceSeconds = 2.5;
+
+    StringArray getStimulusNames() {
+        return { "impulses", "sweep", "noise" };
+    }
+
+    AudioBuffer<float> createStimulus (const String& name, double sampleRate, int numChannels) {
+        auto signalLength = (int) (1.0 * sampleRate);
+        AudioBuffer<float> buffer(numChannels, signalLength + (int) (silenceSeconds * sampleRate));
+        buffer.clear();
+
+        if (name == "impulses") {
+            // Four full-scale clicks, a little later on each channel than the one before
+            for (int i = 0; i < 4; i++) {
+                auto position = (int) (i * 0.25 * sampleRate);
+
+                for (int channel = 0; channel < numChannels; channel++) {
+                    buffer.setSample(channel, position + 7 * channel, 1.0f);
+                }
+            }
+        } else if (name == "sweep") {
+            // Exponential sine sweep from 20 Hz to 20 kHz at -6 dBFS
+            auto startFrequency = 20.0, endFrequency = jmin(20000.0, sampleRate * 0.45);
+            auto sweepRate = std::log(endFrequency / startFrequency);
+
+            for (int i = 0; i < signalLength; i++) {
+                auto t = i / sampleRate;
+                auto phase = MathConstants<double>::twoPi * startFrequency * (std::exp(t * sweepRate) - 1.0) / sweepRate;
+                auto sample = (float) (0.5 * std::sin(phase));
+
+                for (int channel = 0; channel < numChannels; channel++) {
+                    buffer.setSample(channel, i, sample);
+                }
+            }
+        } else if (name == "noise") {
+            Random random(0x5eed);
+
+            for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
+                for (int i = 0; i < signalLength; i++) {
+                    buffer.setSample(channel, i, random.nextFloat() - 0.5f);
+                }
+            }
+        }
+
+        return buffer;
+    }
+
+    //==============================================================================
+    /** Renders the case at the stimulus's length. In double precision the stimulus is converted up, and the
+        output back down, so it can be compared with the float references.
+     */
+    AudioBuffer<float> render (const RegressionCase& regressionCase, const AudioBuffer<float>& stimulus,
+                               double sampleRate, int blockSize) {
+        auto processor = createProcessor(regressionCase.plugin);
+        auto automation = regressionCase.automation;
+
+        std::stable_sort(automation.begin(), automation.end(),
+                         [] (const ParameterChange& a, const ParameterChange& b) { return a.timeInSeconds < b.timeInSeconds; });
+
+        // Initial settings have to be in place before prepareToPlay(), which reads some of them
+        size_t nextChange = 0;
+
+        while (nextChange < automation.size() && automation[nextChange].timeInSeconds <= 0) {
+            OfflineRenderer::setParameter(*processor, automation[nextChange].paramID, automation[nextChange].value);
+            nextChange++;
+        }
+
+        // The way a host reopens a session
+        if (regressionCase.restoredFromState) {
+            MemoryBlock state;
+            processor->getStateInformation(state);
+
+            processor = createProcessor(regressionCase.plugin);
+            processor->setStateInformation(state.getData(), (int) state.getSize());
+        }
+
+        if (regressionCase.numChannels > 0 && ! OfflineRenderer::setNumChannels(*processor, regressionCase.numChannels)) {
+            ConsoleApplication::fail("The " + regressionCase.plugin + " doesn't support " + String(regressionCase.numChannels) + " channels");
+        }
+
+        OfflineRenderer renderer(*processor, sampleRate, blockSize, regressionCase.precision);
+
+        if (regressionCase.live) {
+            processor->setNonRealtime(false);
+            processor->prepareToPlay(sampleRate, blockSize);
+        }
+
+        // Oversampling delays the output, so render that much further and drop it from the start, as
+        // renderFile() does. The output then lines up with the stimulus only if the latency is right.
+        const int latency = processor->getLatencySamples();
+        const int numSamples = stimulus.getNumSamples();
+
+        AudioBuffer<float> buffer(renderer.getNumChannels(), numSamples + latency);
+
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
+            buffer.copyFrom(channel, 0, stimulus, channel % stimulus.getNumChannels(), 0, numSamples);
+            buffer.clear(channel, numSamples, latency);
+        }
+
+        // Changes land on the first block boundary at or after their time, the way most hosts apply automation
+        auto processWithAutomation = [&] (auto& block) {
+            for (int position = 0; position < block.getNumSamples(); position += blockSize) {
+                while (nextChange < automation.size() && automation[nextChange].timeInSeconds * sampleRate <= position) {
+                    OfflineRenderer::setParameter(*processor, automation[nextChange].paramID, automation[nextChange].value);
+                    nextChange++;
+                }
+
+                renderer.process(block, position, jmin(blockSize, block.getNumSamples() - position));
+            }
+        };
+
+        if (processor->isUsingDoublePrecision()) {
+            AudioBuffer<double> doubleBuffer;
+            doubleBuffer.makeCopyOf(buffer);
+            processWithAutomation(doubleBuffer);
+            buffer.makeCopyOf(doubleBuffer);
+        } else {
+            processWithAutomation(buffer);
+        }
+
+        AudioBuffer<float> output(processor->getTotalNumOutputChannels(), numSamples);
+
+        for (int channel = 0; channel < output.getNumChannels(); channel++) {
+            output.copyFrom(channel, 0, buffer, channel, latency, numSamples);
+        }
+
+        return output;
+    }
+
+    //==============================================================================
+    /** Random tap tables that hold still, which modelTaps() can follow: times, gains, pans, feedback and cross
+        feedback, with linear interpolation and the filters off. With more than a couple of taps the feedback
+        adds up to more than 1, and is scaled down.
+     */
+    std::vector<RegressionCase> createModelledCases() {
+        std::vector<RegressionCase> cases;
+        Random random(0x7a95);
+
+        for (int numTaps : { 1, 2, 5, 16 }) {
+            for (int numChannels : { 1, 2, 3, 6 }) {
+                std::vector<ParameterChange> settings = { { 0.0, "drywet", 0.6f }, { 0.0, "feedback", 0.8f },
+                                                          { 0.0, "taps", (float) numTaps } };
+
+                for (int tap = 0; tap < numTaps; tap++) {
+                    const String id = "tap" + String(tap + 1);
+
+                    settings.push_back({ 0.0, tap == 0 ? String("delaytime") : id + "time", 0.1f + 0.3f * random.nextFloat() });
+                    settings.push_back({ 0.0, id + "gain", random.nextFloat() });
+                    settings.push_back({ 0.0, id + "pan", random.nextFloat() * 2 - 1 });
+                    settings.push_back({ 0.0, id + "feedback", random.nextFloat() });
+                    settings.push_back({ 0.0, id + "cross", random.nextFloat() });
+                }
+
+                cases.push_back({ "delay", "model-" + String(numTaps) + "-taps-" + String(numChannels) + "-channels",
+                                  settings, { "noise" }, numChannels });
+            }
+        }
+
+        return cases;
+    }
+
+    /** The delay worked out a sample at a time in double precision, the plainest way there is. Every tap reads
+        each channel with linear interpolation, is balanced across its pair, and feeds back into its own
+        channel and, by its cross amount, its partner's, scaled down if the taps' feedback adds up to more
+        than 1. Only for settings that hold still, as createModelledCases() makes them.
+     */
+    AudioBuffer<float> modelTaps (const RegressionCase& regressionCase, const AudioBuffer<float>& stimulus, double sampleRate) {
+        // The settings as the delay sees them, snapped to their steps
+        auto processor = createProcessor(regressionCase.plugin);
+
+        for (auto& change : regressionCase.automation) {
+            OfflineRenderer::setParameter(*processor, change.paramID, change.value);
+        }
+
+        auto get = [&processor] (const String& paramID) { return OfflineRenderer::getParameter(*processor, paramID); };
+
+        const int numChannels = stimulus.getNumChannels();
+        const int numSamples = stimulus.getNumSamples();
+        const int numTaps = (int) get("taps");
+        const double dryWet = get("drywet");
+        const double feedback = get("feedback");
+
+        struct ModelTap { float delayInSamples; double gain, pan, feedback, cross; };
+        std::vector<ModelTap> taps;
+        float totalTapFeedback = 0;
+
+        for (int tap = 0; tap < numTaps; tap++) {
+            const String id = "tap" + String(tap + 1);
+
+            // The delay has the time in samples as a float too
+            const float time = get(tap == 0 ? String("delaytime") : id + "time");
+            taps.push_back({ time * (float) sampleRate, get(id + "gain"), get(id + "pan"), get(id + "feedback"), get(id + "cross") });
+            totalTapFeedback += get(id + "feedback");
+        }
+
+        const double feedbackScale = 1.0f / jmax(1.0f, totalTapFeedback);
+
+        std::vector<std::vector<double>> delayLines((size_t) numChannels, std::vector<double>((size_t) numSamples));
+        std::vector<double> feedbackStates((size_t) numChannels);
+        std::vector<double> tapSamples((size_t) (numTaps * numChannels));
+        AudioBuffer<float> output(numChannels, numSamples);
+
+        for (int i = 0; i < numSamples; i++) {
+            for (int tap = 0; tap < numTaps; tap++) {
+                const int wholeDelay = (int) taps[(size_t) tap].delayInSamples;
+                const double fraction = taps[(size_t) tap].delayInSamples - wholeDelay;
+
+                for (int channel = 0; channel < numChannels; channel++) {
+                    auto& delayLine = delayLines[(size_t) channel];
+                    auto at = [&delayLine] (int position) { return position >= 0 ? delayLine[(size_t) position] : 0.0; };
+
+                    tapSamples[(size_t) (tap * numChannels + channel)] = at(i - wholeDelay) + fraction * (at(i - wholeDelay - 1) - at(i - wholeDelay));
+                }
+            }
+
+            for (int channel = 0; channel < numChannels; channel++) {
+                const int partner = channel ^ 1;
+                const bool isPaired = partner < numChannels;
+                double wet = 0, tapFeedback = 0;
+
+                for (int tap = 0; tap < numTaps; tap++) {
+                    const auto& t = taps[(size_t) tap];
+                    const double sample = tapSamples[(size_t) (tap * numChannels + channel)];
+                    const double send = t.feedback * feedbackScale;
+
+                    if (isPaired) {
+                        const double balance = channel % 2 == 0 ? (t.pan > 0 ? 1 - t.pan : 1) : (t.pan < 0 ? 1 + t.pan : 1);
+                        wet += t.gain * balance * sample;
+                        tapFeedback += send * ((1 - t.cross) * sample + t.cross * tapSamples[(size_t) (tap * numChannels + partner)]);
+                    } else {
+                        wet += t.gain * sample;
+                        tapFeedback += send * sample;
+                    }
+                }
+
+                // The feedback goes in with the next sample
+                const double input = stimulus.getSample(channel, i);
+                output.setSample(channel, i, (float) (input * (1 - dryWet) + wet * dryWet));
+                delayLines[(size_t) channel][(size_t) i] = input + feedbackStates[(size_t) channel];
+                feedbackStates[(size_t) channel] = feedback * tapFeedback;
+            }
+        }
+
+        return output;
+    }
+
+    //==============================================================================
+    struct Difference {
+        bool identical = true;
+        float maxAbsError = 0;
+        double rmsError = 0;
+    };
+
+    Difference compare (const AudioBuffer<float>& output, const AudioBuffer<float>& reference) {
+        Difference difference;
+        double sumOfSquares = 0;
+
+        for (int channel = 0; channel < output.getNumChannels(); channel++) {
+            auto* outputData = output.getReadPointer(channel);
+            auto* referenceData = reference.getReadPointer(channel);
+
+            for (int i = 0; i < output.getNumSamples(); i++) {
+                auto error = outputData[i] - referenceData[i];
+
+                // Compare bit patterns so that differing NaNs or -0 vs +0 still count
+                if (std::memcmp(outputData + i, referenceData + i, sizeof(float)) != 0) {
+                    difference.identical = false;
+                }
+
+                difference.maxAbsError = jmax(difference.maxAbsError, std::abs(error));
+                sumOfSquares += (double) error * error;
+            }
+        }
+
+        difference.rmsError = std::sqrt(sumOfSquares / jmax(1, output.getNumChannels() * output.getNumSamples()));
+        return difference;
+    }
+
+    /** How close an output has to be to a reference, or to the same case rendered another way. */
+    struct Limits {
+        bool exact;
+        double maxAbsErrorDb;
+        double rmsErrorDb;
+    };
+
+    /** Prints whether the output is within the limits of the reference, and returns true if it is. */
+    bool checkOutput (const AudioBuffer<float>& output, const AudioBuffer<float>& reference, const Limits& limits) {
+        if (reference.getNumChannels() != output.getNumChannels() || reference.getNumSamples() != output.getNumSamples()) {
+            std::cout << "FAIL  reference has a different length or channel count" << std::endl;
+            return false;
+        }
+
+        auto difference = compare(output, reference);
+        auto maxAbsDb = Decibels::gainToDecibels(difference.maxAbsError, -300.0f);
+        auto rmsDb = Decibels::gainToDecibels(difference.rmsError, -300.0);
+
+        auto passed = limits.exact ? difference.identical
+                                   : (maxAbsDb <= limits.maxAbsErrorDb && rmsDb <= limits.rmsErrorDb);
+
+        std::cout << (passed ? "ok    " : "FAIL  ")
+                  << (difference.identical ? String("bit-exact")
+                                           : "max abs " + String(maxAbsDb, 1) + " dB, rms " + String(rmsDb, 1) + " dB")
+                  << std::endl;
+
+        return passed;
+    }
+
+    /** Another way of running a plugin's cases, which has to match the plugin's own output within the
+        given limits rather than a reference of its own. Variants in double precision skip the cases that
+        already are, and the rest run at the case's precision. Restoring runs every case from a fresh
+        instance given the first's state, so anything the state leaves out shows up.
+     */
+    struct Variant {
+        String name;
+        String plugin;
+        String variantPlugin;
+        Limits limits;
+        bool inDoublePrecision = false;
+        bool restoredFromState = false;
+    };
+
+    std::vector<Variant> createVariants() {
+        return {
+            // Interleaving only changes where the samples live, including the planar channel left over
+            // from an odd count, so it has to be exact
+            { "interleaved", "delay", "delay-interleaved", { true, 0, 0 } },
+
+            // 16-bit storage adds dither and rounding each time a sample goes through the line, about -84 dB
+            // below 0 dBFS, and the feedback sends it round again. The worst case, an automated sweep at
+            // 0.5 feedback, measures -60 dB max abs and -79 dB RMS, so these leave 6 dB of headroom.
+            { "compact", "delay", "delay-compact", { false, -54.0, -73.0 } },
+
+            // processBlock (AudioBuffer<double>&) runs the same code on doubles, so the gain and the chorus only
+            // differ by float rounding, -130 dB at worst. A float delay line can't place a read more finely
+            // than an ulp of its delay in samples, about 1/1000 of a sample at 0.3s and 1/250 at 1.2s, so the
+            // delay's outputs are only within -60 dB or so. This still catches a broken double path, and the double cases
+            // with references of their own hold it to the usual limits.
+            { "double", "gain",   "gain",   { false, -120.0, -140.0 }, true },
+            { "double", "delay",  "delay",  { false, -55.0, -70.0 }, true },
+            { "double", "chorus", "chorus", { false, -120.0, -140.0 }, true },
+
+            { "restored", "delay",  "delay",  { true, 0, 0 }, false, true },
+            { "restored", "chorus", "chorus", { true, 0, 0 }, false, true },
+        };
+    }
+
+    bool writeWav (const File& file, const AudioBuffer<float>& buffer, double sampleRate) {
+        file.deleteFile();
+        std::unique_ptr<FileOutputStream> stream(file.createOutputStream());
+
+        if (stream == nullptr || stream->failedToOpen()) {
+            return false;
+        }
+
+        // 32-bit float, so references round-trip exactly
+        WavAudioFormat wavFormat;
+        std::unique_ptr<AudioFormatWriter> writer(wavFormat.createWriterFor(stream.get(), sampleRate,
+                                                                            (unsigned int) buffer.getNumChannels(), 32, {}, 0));
+
+        if (writer == nullptr) {
+            return false;
+        }
+
+        stream.release();
+        return writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+    }
+
+    /** The References folder checked in beside OfflineRender.jucer, found by walking up from the binary. */
+    File getDefaultReferenceFolder() {
+        for (auto folder = File::getSpecialLocation(File::currentExecutableFile).getParentDirectory();
+             ! folder.isRoot(); folder = folder.getParentDirectory()) {
+            if (folder.getChildFile("OfflineRender.jucer").existsAsFile()) {
+                return folder.getChildFile("References");
+            }
+        }
+
+        // A binary copied out of the repo, so assume it's being run from the repo's root
+        return File::getCurrentWorkingDirectory().getChildFile("OfflineRender/References");
+    }
+
+    bool readWav (const File& file, AudioBuffer<float>& buffer) {
+        WavAudioFormat wavFormat;
+        std::unique_ptr<AudioFormatReader> reader(wavFormat.createReaderFor(file.createInputStream(), true));
+
+        if (reader == nullptr) {
+            return false;
+        }
+
+        buffer.setSize((int) reader->numChannels, (int) reader->lengthInSamples);
+        return reader->read(&buffer, 0, (int) reader->lengthInSamples, 0, true, true);
+    }
+}
+
+//==============================================================================
+void runRegression (const ArgumentList& args) {
+    auto referenceFolder = args.containsOption("--references") ? args.getFileForOption("--references")
+                                                               : getDefaultReferenceFolder();
+    auto pluginFilter = args.getValueForOption("--plugin");
+    auto update = args.containsOption("--update");
+
+    // Default limits are loose enough for reordered float maths, and tight enough to catch any audible change
+    Limits limits;
+    limits.exact = args.containsOption("--exact");
+    limits.maxAbsErrorDb = args.containsOption("--max-abs-db") ? args.getValueForOption("--max-abs-db").getDoubleValue() : -100.0;
+    limits.rmsErrorDb = args.containsOption("--rms-db") ? args.getValueForOption("--rms-db").getDoubleValue() : -120.0;
+
+    // The level --simd capped the DSP at, or the best the CPU has. Each lower one is checked against it.
+    const auto simdLevel = getSIMDLevel();
+
+    // Changing either of these changes the output, so references are rendered at fixed settings
+    const double sampleRate = 48000.0;
+    const int blockSize = 512;
+
+    if (update && ! referenceFolder.createDirectory()) {
+        ConsoleApplication::fail("Couldn't create " + referenceFolder.getFullPathName());
+    }
+
+    int numFailures = 0;
+
+    for (auto& regressionCase : createRegressionCases()) {
+        if (pluginFilter.isNotEmpty() && ! pluginFilter.equalsIgnoreCase(regressionCase.plugin)) {
+            continue;
+        }
+
+        auto stimulusNames = regressionCase.stimuli.isEmpty() ? getStimulusNames() : regressionCase.stimuli;
+        auto numChannels = regressionCase.numChannels > 0 ? regressionCase.numChannels : 2;
+
+        for (auto& stimulusName : stimulusNames) {
+            auto output = render(regressionCase, createStimulus(stimulusName, sampleRate, numChannels), sampleRate, blockSize);
+            auto testName = regressionCase.plugin + "-" + regressionCase.name + "-" + stimulusName;
+            auto referenceFile = referenceFolder.getChildFile(testName + ".wav");
+
+            std::cout << testName.paddedRight(' ', 52);
+
+            if (update) {
+                if (! writeWav(referenceFile, output, sampleRate)) {
+                    ConsoleApplication::fail("Couldn't write " + referenceFile.getFullPathName());
+                }
+
+                std::cout << "written" << std::endl;
+                continue;
+            }
+
+            AudioBuffer<float> reference;
+
+            if (! referenceFile.existsAsFile() || ! readWav(referenceFile, reference)) {
+                std::cout << "FAIL  missing reference " << referenceFile.getFullPathName() << std::endl;
+                numFailures++;
+            } else if (! checkOutput(output, reference, limits)) {
+                numFailures++;
+            }
+
+            // The same case run with each instruction set below that one has to give the same output,
+            // within the same limits, whatever the reference says
+            for (auto level : { SIMDLevel::baseline, SIMDLevel::avx2 }) {
+                if ((int) level >= (int) simdLevel) {
+                    continue;
+                }
+
+                setMaxSIMDLevel(level);
+                auto levelOutput = render(regressionCase, createStimulus(stimulusName, sampleRate, numChannels), sampleRate, blockSize);
+                setMaxSIMDLevel(simdLevel);
+
+                std::cout << (testName + " @" + getSIMDLevelName(level)).paddedRight(' ', 52);
+
+                if (! checkOutput(levelOutput, output, limits)) {
+                    numFailures++;
+                }
+            }
+
+            for (auto& variant : createVariants()) {
+                if (variant.plugin != regressionCase.plugin
+                    || (variant.inDoublePrecision && regressionCase.precision == AudioProcessor::doublePrecision)) {
+                    continue;
+                }
+
+                auto variantCase = regressionCase;
+                variantCase.plugin = variant.variantPlugin;
+
+                variantCase.restoredFromState = variant.restoredFromState;
+
+                if (variant.inDoublePrecision) {
+                    variantCase.precision = AudioProcessor::doublePrecision;
+                }
+                auto variantOutput = render(variantCase, createStimulus(stimulusName, sampleRate, numChannels), sampleRate, blockSize);
+
+                std::cout << (testName + " " + variant.name).paddedRight(' ', 52);
+
+                if (! checkOutput(variantOutput, output, variant.limits)) {
+                    numFailures++;
+                }
+            }
+        }
+    }
+
+    // The tap tables have a model to match rather than references. Float rounding going round the feedback
+    // loop puts them as much as -102 dB out, and a tap routed wrongly is tens of dB out. They're rendered in
+    // blocks of four pages and more too, which the paged delay lines' spares have to last out.
+    const Limits modelLimits = { false, -90.0, -110.0 };
+    const int longBlockSize = 65536;
+
+    if (pluginFilter.isEmpty() || pluginFilter.equalsIgnoreCase("delay")) {
+        for (auto& modelledCase : createModelledCases()) {
+            auto stimulus = createStimulus(modelledCase.stimuli[0], sampleRate, modelledCase.numChannels);
+            auto model = modelTaps(modelledCase, stimulus, sampleRate);
+
+            for (int modelBlockSize : { blockSize, longBlockSize }) {
+                auto output = render(modelledCase, stimulus, sampleRate, modelBlockSize);
+                auto testName = modelledCase.plugin + "-" + modelledCase.name;
+
+                if (modelBlockSize != blockSize) {
+                    testName += " blocks-" + String(modelBlockSize);
+                }
+
+                std::cout << testName.paddedRight(' ', 52);
+
+                if (! checkOutput(output, model, modelLimits)) {
+                    numFailures++;
+                }
+            }
+        }
+    }
+
+    if (numFailures > 0) {
+        ConsoleApplication::fail(String(numFailures) + " regression tests failed");
+    }
+}
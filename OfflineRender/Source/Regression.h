@@ -0,0 +1,13 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+    Renders fixed stimuli (impulses, a sine sweep and noise, each followed by
+    silence) through every processor with scripted parameter automation, and
+    compares the output against reference WAV files, either bit-exact or within
+    max abs / RMS error limits in dB. With --update it writes the references instead.
+    They live in OfflineRender/References unless --references says otherwise.
+ */
+void runRegression (const ArgumentList& args);